@@ -3,10 +3,14 @@
 * Declaration of the AudioVisualNotifications library for RGB LED and audio status indication.
 *
 * This file contains the declaration for the AudioVisualNotifications library, which facilitates
-* the indication of device status through a NeoPixel LED and audio feedback. The library provides separate functions
+* the indication of device status through status LEDs and audio feedback. The library provides separate functions
 * to control the LED for displaying status in terms of colors, as well as functions to play various melodies for auditory feedback.
 * It is designed to be easily integrated into Arduino projects for visualizing various device states.
 *
+* The library is a template over a light backend and a speaker backend (see NotificationOutputs.h and
+* NeoPixelOutput.h). Pins, pixel count and brightness are template parameters of the backends, so
+* pixel writes beyond the pixel count and melodies on boards without a speaker compile away.
+*
 * @license MIT License
 *
 * Permission is hereby granted, free of charge, to any person obtaining a copy
@@ -32,7 +36,7 @@
 #define AUDIO_VISUAL_NOTIFICATIONS_H
 
 #include "Arduino.h"
-#include "Adafruit_NeoPixel.h"
+#include "NotificationOutputs.h"
 
 // Define piano notes.
 #define NOTE_B0 31
@@ -125,25 +129,18 @@
 #define NOTE_D8 4699
 #define NOTE_DS8 4978
 
+/**
+* Audio-visual status notifications.
+*
+* @tparam LightOutput The light backend, e.g. NeoPixelOutput or GpioLedOutput.
+* @tparam Speaker The speaker backend, e.g. ToneSpeaker or NoSpeaker.
+*/
+template <class LightOutput, class Speaker>
 class AudioVisualNotifications {
 public:
-  /**
-  * Constructs an AudioVisualNotifications object with specified parameters.
-  * Initializes the NeoPixel and speaker pin settings for audio-visual notifications.
-  * 
-  * @param neoPixelPin The GPIO pin connected to the NeoPixel.
-  * @param neoPixelCount The number of NeoPixels in the strip.
-  * @param neoPixelBrightness The brightness level of the NeoPixels (0-255).
-  * @param speakerPin The GPIO pin connected to the speaker.
-  */
-  AudioVisualNotifications(int neoPixelPin, int neoPixelCount, int neoPixelBrightness, int speakerPin);
-
   // Nested class for audio notifications.
   class Audio {
   public:
-    explicit Audio(AudioVisualNotifications& parent)
-      : _parent(parent) {}
-
     /**
     * Plays an introductory audio notification sequence through the speaker.
     * This function produces a series of tones to signal the start of notifications.
@@ -158,7 +155,7 @@ public:
 
     /**
     * Produces a single short beep using the speaker.
-    * The tone is played on the speaker connected to the specified pin.
+    * The tone is played on the speaker of the board profile.
     */
     void beep();
 
@@ -166,74 +163,79 @@ public:
     * Produces a double beep using the speaker.
     * This function generates two consecutive tones, 
     * each lasting 120 milliseconds, with an 80-millisecond pause between them.
-    * The tones are played on the speaker connected to the specified pin.
+    * The tones are played on the speaker of the board profile.
     */
     void doubleBeep();
 
     /**
-    * Produces a double beep using the speaker.
-    * This function generates two consecutive tones, 
+    * Produces a triple beep using the speaker.
+    * This function generates three consecutive tones, 
     * each lasting 120 milliseconds, with an 80-millisecond pause between them.
-    * The tones are played on the speaker connected to the specified pin.
+    * The tones are played on the speaker of the board profile.
     */
     void tripleBeep();
+
+    /**
+    * Returns the speaker backend, e.g. to inspect a mock in host builds.
+    */
+    const Speaker& output() const {
+      return _speaker;
+    }
   private:
-    AudioVisualNotifications& _parent;  // Reference to parent
+    void note(uint16_t frequency, uint32_t duration);
+
+    Speaker _speaker;
   };
 
   // Nested class for visual notifications.
   class Visual {
   public:
-    explicit Visual(AudioVisualNotifications& parent)
-      : _parent(parent) {}
-
     /**
-    * Initializes the visual notifications by setting up the NeoPixel strip.
-    * This function must be called to prepare the NeoPixel for use. 
+    * Initializes the visual notifications by setting up the light backend.
+    * This function must be called to prepare the LEDs for use. 
     */
     void initializePixels();
 
     /**
-    * Clears all visual notifications on the NeoPixel strip.
-    * This function resets the NeoPixel strip to its default state.
+    * Clears all visual notifications.
+    * This function turns every LED off.
     */
     void clearAllPixels();
 
     /**
     * Displays a visual notification indicating that the system is not ready.
-    * This function uses the NeoPixel strip to show a red color on one pixel while turning off another.
+    * This function shows a red color on one pixel while turning off another.
     */
     void notReadyMode();
 
     /**
     * Displays a visual notification indicating that the system is ready to send data.
-    * This function blinks two NeoPixels in green for a specified number of times to signal readiness.
+    * This function blinks two pixels in green for a specified number of times to signal readiness.
     */
     void readyToSendMode();
 
     /**
     * Displays a visual notification indicating that the system is waiting for a GNSS fix.
-    * This function uses the NeoPixel strip to show a blue color on one pixel while turning off another.
+    * This function shows a blue color on one pixel while turning off another.
     */
     void waitingGnssFixMode();
 
     /**
     * Displays a visual notification indicating that the system is loading.
-    * This function uses the NeoPixel strip to show a magenta color on one pixel while turning off another.
+    * This function shows a magenta color on one pixel while turning off another.
     */
     void loadingMode();
 
     /**
     * Displays a visual notification indicating that maintenance is required.
-    * This function uses the NeoPixel strip to show a magenta color on two pixels briefly.
+    * This function shows a magenta color on two pixels briefly.
     */
     void maintenanceMode();
 
     /**
-    * Initializes a specific NeoPixel with the given color values.
-    * This function sets the color of a specified pixel in the NeoPixel strip.
+    * Sets a specific pixel to the given color values and shows it.
     * 
-    * @param pixel The index of the NeoPixel to be initialized.
+    * @param pixel The index of the pixel.
     * @param red The red color value (0-255).
     * @param green The green color value (0-255).
     * @param blue The blue color value (0-255).
@@ -241,29 +243,277 @@ public:
     void singlePixel(int pixel, int red, int green, int blue);
 
     /**
-    * Displays a rainbow animation on the NeoPixel strip.
+    * Displays a rainbow animation.
     * This function cycles through the color wheel, creating a smooth rainbow animation
-    * across all NeoPixels. The animation consists of 1280 passes through the loop,
+    * across all pixels. The animation consists of 1280 passes through the loop,
     * with a short delay between updates to achieve a smooth transition.
     *
-    * The animation uses the built-in `rainbow` function of the NeoPixel library, 
-    * which generates a sequence of colors based on the hue.
-    *
-    * Note: The brightness and gamma correction are set to default values.
+    * Note: Colors are not gamma corrected.
     */
     void rainbowMode();
+
+    /**
+    * Returns the light backend, e.g. to inspect a mock in host builds.
+    */
+    const LightOutput& output() const {
+      return _output;
+    }
   private:
-    AudioVisualNotifications& _parent;  // Reference to parent
+    void setPixel(uint8_t pixel, uint8_t red, uint8_t green, uint8_t blue);
+    void alternate(uint8_t red, uint8_t green, uint8_t blue, uint32_t interval);
+
+    LightOutput _output;
   };
 
   Audio audio;
   Visual visual;
-private:
-  int _neoPixelPin;
-  int _neoPixelCount;
-  int _neoPixelBrightness;
-  int _speakerPin;
-  Adafruit_NeoPixel _neoPixel;  // Declare neoPixel as a member variable.
 };
 
+/**
+* Plays an introductory audio notification sequence through the speaker.
+* This function produces a series of tones to signal the start of notifications.
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Audio::introMelody() {
+  note(NOTE_E6, 120);
+  note(NOTE_F6, 120);
+  note(NOTE_G6, 320);
+}
+
+/**
+* Plays a maintenance audio notification sequence through the speaker.
+* This function produces a series of tones to signal maintenance notifications.
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Audio::maintenanceMelody() {
+  if (!Speaker::enabled) {
+    return;
+  }
+
+  // First part.
+  note(NOTE_E6, 120);
+  delay(80);
+  note(NOTE_E6, 120);
+  delay(80);
+  note(NOTE_F6, 120);
+  delay(80);
+  note(NOTE_G6, 280);
+
+  // Second part.
+  note(NOTE_E6, 120);
+  note(NOTE_F6, 120);
+  note(NOTE_G6, 320);
+}
+
+/**
+* Produces a single short beep using the speaker.
+* The tone is played on the speaker of the board profile.
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Audio::beep() {
+  note(NOTE_E6, 120);
+}
+
+/**
+* Produces a double beep using the speaker.
+* This function generates two consecutive tones, 
+* each lasting 120 milliseconds, with an 80-millisecond pause between them.
+* The tones are played on the speaker of the board profile.
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Audio::doubleBeep() {
+  if (!Speaker::enabled) {
+    return;
+  }
+
+  note(NOTE_E6, 120);
+  delay(80);
+  note(NOTE_E6, 120);
+}
+
+/**
+* Produces a triple beep using the speaker.
+* This function generates three consecutive tones, 
+* each lasting 120 milliseconds, with an 80-millisecond pause between them.
+* The tones are played on the speaker of the board profile.
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Audio::tripleBeep() {
+  if (!Speaker::enabled) {
+    return;
+  }
+
+  note(NOTE_E6, 120);
+  delay(80);
+  note(NOTE_E6, 120);
+  delay(80);
+  note(NOTE_E6, 120);
+}
+
+// Boards without a speaker skip the note and its duration.
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Audio::note(uint16_t frequency, uint32_t duration) {
+  if (!Speaker::enabled) {
+    return;
+  }
+
+  _speaker.play(frequency);
+  delay(duration);
+  _speaker.stop();
+}
+
+/**
+* Initializes the visual notifications by setting up the light backend.
+* This function must be called to prepare the LEDs for use. 
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Visual::initializePixels() {
+  _output.begin();
+}
+
+/**
+* Clears all visual notifications.
+* This function turns every LED off.
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Visual::clearAllPixels() {
+  _output.clear();
+  _output.show();
+}
+
+/**
+* Displays a visual notification indicating that the system is not ready.
+* This function shows a red color on one pixel while turning off another.
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Visual::notReadyMode() {
+  alternate(255, 0, 0, 240);
+}
+
+/**
+* Displays a visual notification indicating that the system is ready to send data.
+* This function blinks two pixels in green for a specified number of times to signal readiness.
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Visual::readyToSendMode() {
+  uint32_t delayBeforeNextBurst = 1200;
+  int blinkCount = 4;
+
+  // Loop through the specified number of blinks in one burst.
+  for (int i = 0; i < blinkCount; ++i) {
+    setPixel(0, 0, 255, 0);
+    setPixel(1, 0, 255, 0);
+    _output.show();
+
+    delay(40);
+    clearAllPixels();
+    delay(40);
+  }
+
+  // Add a delay before starting the next burst.
+  delay(delayBeforeNextBurst);
+}
+
+/**
+* Displays a visual notification indicating that the system is waiting for a GNSS fix.
+* This function shows a blue color on one pixel while turning off another.
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Visual::waitingGnssFixMode() {
+  alternate(0, 0, 255, 240);
+}
+
+/**
+* Displays a visual notification indicating that the system is loading.
+* This function shows a magenta color on one pixel while turning off another.
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Visual::loadingMode() {
+  alternate(255, 0, 255, 240);
+}
+
+/**
+* Displays a visual notification indicating that maintenance is required.
+* This function shows a magenta color on two pixels briefly.
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Visual::maintenanceMode() {
+  uint32_t interval = 240;
+
+  setPixel(0, 255, 0, 255);
+  setPixel(1, 255, 0, 255);
+  _output.show();
+
+  delay(interval);
+  clearAllPixels();
+  delay(interval);
+}
+
+/**
+* Sets a specific pixel to the given color values and shows it.
+* 
+* @param pixel The index of the pixel.
+* @param red The red color value (0-255).
+* @param green The green color value (0-255).
+* @param blue The blue color value (0-255).
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Visual::singlePixel(int pixel, int red, int green, int blue) {
+  if (pixel < 0) {
+    return;
+  }
+
+  setPixel(pixel, red, green, blue);
+  _output.show();
+}
+
+/**
+* Displays a rainbow animation.
+* This function cycles through the color wheel, creating a smooth rainbow animation
+* across all pixels. The animation consists of 1280 passes through the loop,
+* with a short delay between updates to achieve a smooth transition.
+*
+* Note: Colors are not gamma corrected.
+*/
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Visual::rainbowMode() {
+  for (long firstPixelHue = 0; firstPixelHue < 5 * 65536; firstPixelHue += 256) {
+    for (uint8_t i = 0; i < LightOutput::count; i++) {
+      // Spread one turn of the color wheel over the pixels, then map the hue to 1530 steps of RGB.
+      uint32_t hue = ((firstPixelHue + i * 65536L / LightOutput::count) & 0xFFFF) * 1530 / 65536;
+      uint8_t red = hue < 255 ? 255 : hue < 510 ? 510 - hue : hue < 1020 ? 0 : hue < 1275 ? hue - 1020 : 255;
+      uint8_t green = hue < 255 ? hue : hue < 510 ? 255 : hue < 765 ? 255 : hue < 1020 ? 1020 - hue : 0;
+      uint8_t blue = hue < 510 ? 0 : hue < 765 ? hue - 510 : hue < 1275 ? 255 : 1530 - hue;
+      setPixel(i, red, green, blue);
+    }
+
+    _output.show();
+    delay(12);
+  }
+}
+
+// Writes beyond the pixel count of the board are dropped, with a constant count this compiles away.
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Visual::setPixel(uint8_t pixel, uint8_t red, uint8_t green, uint8_t blue) {
+  if (pixel < LightOutput::count) {
+    _output.set(pixel, red, green, blue);
+  }
+}
+
+// Lights the first pixel, then the second one, each for the given interval.
+template <class LightOutput, class Speaker>
+void AudioVisualNotifications<LightOutput, Speaker>::Visual::alternate(uint8_t red, uint8_t green, uint8_t blue, uint32_t interval) {
+  setPixel(0, red, green, blue);
+  setPixel(1, 0, 0, 0);
+  _output.show();
+
+  delay(interval);
+
+  setPixel(0, 0, 0, 0);
+  setPixel(1, red, green, blue);
+  _output.show();
+
+  delay(interval);
+}
+
 #endif
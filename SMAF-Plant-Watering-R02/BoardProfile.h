@@ -0,0 +1,80 @@
+/**
+* BoardProfile.h
+* Compile-time board profiles.
+*
+* This file contains the pin assignment and status outputs of every supported board. A profile is
+* selected with BOARD_PROFILE, e.g. as a build flag, and provides a constexpr boardProfile and the
+* matching BoardNotifications type. Nothing here is decided at runtime, so a board variant only
+* carries the code and memory of the outputs it actually has.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef BOARD_PROFILE_H
+#define BOARD_PROFILE_H
+
+#include "Arduino.h"
+#include "AudioVisualNotifications.h"
+#include "NotificationOutputs.h"
+
+// Struct to hold the pin assignment of a board, -1 for a pin that is not connected.
+struct BoardProfile {
+  const char* name;                // Short board name for the boot log.
+  int8_t pixelPin;                 // NeoPixel data pin, or the pin of a single status LED.
+  uint8_t pixelCount;              // Number of status pixels.
+  uint8_t pixelBrightness;         // NeoPixel brightness (0-255).
+  int8_t speakerPin;               // Speaker for the melodies and beeps.
+  int8_t configurationButtonPin;   // Held low at boot to start the setup portal.
+  int8_t moistureSensorPin;        // Analog moisture sensor input.
+  int8_t solenoidPin;              // Solenoid valve output, first H-bridge pin for latching valves.
+  int8_t solenoidPinB;             // Second H-bridge pin for latching valves.
+};
+
+// Predefined board profiles.
+#define BOARD_SMAF_R02 0   // Reference board, two NeoPixels and a speaker.
+#define BOARD_GPIO_LED 1   // Same wiring with a single status LED on a GPIO and no speaker.
+#define BOARD_HOST 2       // Host builds, pixels and speaker are recorded by mocks.
+
+#ifndef BOARD_PROFILE
+#define BOARD_PROFILE BOARD_SMAF_R02
+#endif
+
+#if BOARD_PROFILE == BOARD_SMAF_R02
+#include "NeoPixelOutput.h"
+constexpr BoardProfile boardProfile = { "smaf-r02", 4, 2, 30, 5, 6, 3, 8, -1 };
+typedef NeoPixelOutput<boardProfile.pixelPin, boardProfile.pixelCount, boardProfile.pixelBrightness> BoardLightOutput;
+typedef ToneSpeaker<boardProfile.speakerPin> BoardSpeaker;
+#elif BOARD_PROFILE == BOARD_GPIO_LED
+constexpr BoardProfile boardProfile = { "gpio-led", 4, 1, 0, -1, 6, 3, 8, -1 };
+typedef GpioLedOutput<boardProfile.pixelPin> BoardLightOutput;
+typedef NoSpeaker BoardSpeaker;
+#elif BOARD_PROFILE == BOARD_HOST
+constexpr BoardProfile boardProfile = { "host", -1, 2, 30, -1, -1, -1, -1, -1 };
+typedef MockLightOutput<boardProfile.pixelCount> BoardLightOutput;
+typedef MockSpeaker BoardSpeaker;
+#else
+#error "Unknown BOARD_PROFILE."
+#endif
+
+// Status LED and speaker of the selected board.
+typedef AudioVisualNotifications<BoardLightOutput, BoardSpeaker> BoardNotifications;
+
+#endif
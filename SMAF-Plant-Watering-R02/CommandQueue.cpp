@@ -0,0 +1,247 @@
+/**
+* CommandQueue.cpp
+* Implementation of the command queue between the MQTT callback and the valve.
+*
+* This file contains the implementation for the CommandQueue class.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+#include "CommandQueue.h"
+
+/**
+* Constructs a CommandQueue object.
+* Call begin() before pushing commands.
+*/
+CommandQueue::CommandQueue()
+  : _queue(NULL),
+    _hasPending(false),
+    _pendingOpen(false),
+    _pendingHeld(false),
+    _hasParams(false),
+    _params{},
+    _pendingQueuedAt(0),
+    _latencyPending(false),
+    _latencyQueuedAt(0),
+    _stats{ 0, 0, 0, 0 },
+    _latency{ 0, UINT32_MAX, 0, 0, 0 },
+    _latencyLock(portMUX_INITIALIZER_UNLOCKED),
+    _statsLock(portMUX_INITIALIZER_UNLOCKED) {
+}
+
+/**
+* Creates the underlying FreeRTOS queue.
+*
+* @return true if the queue was created; false otherwise.
+*/
+bool CommandQueue::begin() {
+  if (_queue == NULL) {
+    _queue = xQueueCreate(COMMAND_QUEUE_DEPTH, sizeof(ControlCommand));
+  }
+
+  return _queue != NULL;
+}
+
+/**
+* Pushes a valve command without blocking.
+* Safe to call from the MQTT callback and the local endpoint.
+*
+* @param open True to open the valve, false to close it.
+* @return true if the command was queued; false if it was dropped.
+*/
+bool CommandQueue::pushValve(bool open) {
+  ControlCommand command;
+  command.type = COMMAND_VALVE;
+  command.open = open;
+  command.queuedAt = micros();
+
+  return send(command);
+}
+
+/**
+* Pushes a full parameter set without blocking.
+* Safe to call from the MQTT callback and the local endpoint.
+*
+* @param params The new controller parameters.
+* @return true if the command was queued; false if it was dropped.
+*/
+bool CommandQueue::pushParams(const WateringParams& params) {
+  ControlCommand command;
+  command.type = COMMAND_PARAMS;
+  command.open = false;
+  command.params = params;
+  command.queuedAt = micros();
+
+  return send(command);
+}
+
+/**
+* Drains the queue and applies commands to the controller.
+* Must be called from the task that owns the valve. Waits up to the given time for the first command.
+* Only the latest valve command is kept, and it is applied once the valve has dwelled long enough.
+* Only the latest parameter set of a burst is applied, and it is saved once.
+*
+* @param controller The controller that owns the valve.
+* @param wait Maximum time to wait for a command in ticks.
+* @return true if at least one command was received; false otherwise.
+*/
+bool CommandQueue::process(WateringController& controller, TickType_t wait) {
+  ControlCommand command;
+  bool received = false;
+
+  // Only a switch in the same control tick as the command counts as its latency.
+  _latencyPending = false;
+
+  // A pending valve command must not wait longer than its remaining dwell time.
+  if (_hasPending) {
+    uint32_t elapsed = millis() - controller.lastValveChange();
+    TickType_t remaining = elapsed >= VALVE_MIN_DWELL_MS ? 0 : pdMS_TO_TICKS(VALVE_MIN_DWELL_MS - elapsed) + 1;
+    wait = min(wait, remaining);
+  }
+
+  // Wait for the first command, then drain whatever else arrived in the same burst.
+  while (_queue != NULL && xQueueReceive(_queue, &command, received ? 0 : wait) == pdTRUE) {
+    receive(command, controller);
+    received = true;
+  }
+
+  // Every parameter set is complete, so one write to flash covers the whole burst.
+  if (_hasParams) {
+    _hasParams = false;
+    controller.setParams(_params);
+    controller.saveParams();
+  }
+
+  // Commands that do not change the valve state need no dwell. They still reach the controller,
+  // which hands a running automatic cycle over to manual control, but they count as merged.
+  if (_hasPending && _pendingOpen == controller.isValveOpen()) {
+    controller.requestManual(_pendingOpen);
+    _hasPending = false;
+    count(_stats.merged);
+  } else if (_hasPending && millis() - controller.lastValveChange() >= VALVE_MIN_DWELL_MS) {
+    controller.requestManual(_pendingOpen);
+    _hasPending = false;
+    count(_stats.applied);
+
+    // Commands held back by the dwell time would only measure the dwell time.
+    _latencyPending = !_pendingHeld;
+    _latencyQueuedAt = _pendingQueuedAt;
+  }
+
+  if (_hasPending) {
+    _pendingHeld = true;
+  }
+
+  return received;
+}
+
+/**
+* Returns the command counters.
+* Safe to call from any task.
+*
+* @return Copy of the command counters.
+*/
+CommandQueueStats CommandQueue::stats() const {
+  portENTER_CRITICAL(&_statsLock);
+  CommandQueueStats copy = _stats;
+  portEXIT_CRITICAL(&_statsLock);
+
+  return copy;
+}
+
+/**
+* Records the command-to-valve latency after the controller switched the valve.
+* Must be called from the task that owns the valve, right after the valve output changed.
+* Does nothing unless the switch was caused by a command applied in the last call to process().
+*/
+void CommandQueue::valveSwitched() {
+  if (!_latencyPending) {
+    return;
+  }
+
+  _latencyPending = false;
+  uint32_t sample = micros() - _latencyQueuedAt;
+
+  portENTER_CRITICAL(&_latencyLock);
+  _latency.samples++;
+  _latency.minUs = min(_latency.minUs, sample);
+  _latency.maxUs = max(_latency.maxUs, sample);
+  _latency.sumUs += sample;
+  _latency.sumSquares += (uint64_t)sample * sample;
+  portEXIT_CRITICAL(&_latencyLock);
+}
+
+/**
+* Returns the command-to-valve latency statistics.
+* Safe to call from any task.
+*
+* @return Copy of the latency statistics.
+*/
+CommandLatencyStats CommandQueue::latency() const {
+  portENTER_CRITICAL(&_latencyLock);
+  CommandLatencyStats copy = _latency;
+  portEXIT_CRITICAL(&_latencyLock);
+
+  return copy;
+}
+
+bool CommandQueue::send(const ControlCommand& command) {
+  if (_queue == NULL || xQueueSend(_queue, &command, 0) != pdTRUE) {
+    count(_stats.dropped);
+    return false;
+  }
+
+  count(_stats.received);
+  return true;
+}
+
+// Commands are pushed from more than one task, so every counter is updated under the lock.
+void CommandQueue::count(uint32_t& counter) {
+  portENTER_CRITICAL(&_statsLock);
+  counter++;
+  portEXIT_CRITICAL(&_statsLock);
+}
+
+void CommandQueue::receive(const ControlCommand& command, WateringController& controller) {
+  switch (command.type) {
+    case COMMAND_VALVE:
+      // A newer valve command supersedes one that has not been applied yet.
+      if (_hasPending) {
+        count(_stats.merged);
+      }
+
+      _hasPending = true;
+      _pendingOpen = command.open;
+      _pendingHeld = false;
+      _pendingQueuedAt = command.queuedAt;
+      break;
+    case COMMAND_PARAMS:
+      // A newer parameter set supersedes one that has not been applied yet.
+      if (_hasParams) {
+        count(_stats.merged);
+      }
+
+      _hasParams = true;
+      _params = command.params;
+      break;
+  }
+}
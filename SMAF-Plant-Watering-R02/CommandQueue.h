@@ -0,0 +1,160 @@
+/**
+* CommandQueue.h
+* Declaration of the command queue between the MQTT callback and the valve.
+*
+* This file contains the declaration for the CommandQueue class. The MQTT callback only pushes
+* decoded commands into a bounded FreeRTOS queue and returns; the task that owns the valve drains
+* the queue, merges redundant valve commands and enforces a minimum dwell time between valve
+* changes, so bursts of retained or duplicated messages cannot make the valve chatter.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include "Arduino.h"
+#include "WateringController.h"
+
+// Define the queue depth and the minimum time between two manual valve changes.
+#define COMMAND_QUEUE_DEPTH 8
+#define VALVE_MIN_DWELL_MS 2000
+
+// Enum to represent the queued command types.
+enum CommandTypeEnum : byte {
+  COMMAND_VALVE,  // Open or close the valve.
+  COMMAND_PARAMS  // Replace the controller parameters.
+};
+
+// Struct to hold a queued command.
+struct ControlCommand {
+  CommandTypeEnum type;   // Command type.
+  bool open;              // Requested valve state for COMMAND_VALVE.
+  WateringParams params;  // Parameters for COMMAND_PARAMS.
+  uint32_t queuedAt;      // Time the command was queued in microseconds.
+};
+
+// Struct to hold the command counters.
+struct CommandQueueStats {
+  uint32_t received;  // Commands pushed into the queue.
+  uint32_t dropped;   // Commands rejected because the queue was full.
+  uint32_t merged;    // Commands superseded before they were applied, and valve commands that did not change the valve.
+  uint32_t applied;   // Valve commands that changed the valve, handed to the controller.
+};
+
+// Struct to hold the command-to-valve latency of commands that were not held back by the dwell time.
+struct CommandLatencyStats {
+  uint32_t samples;     // Number of measured commands.
+  uint32_t minUs;       // Shortest latency in microseconds.
+  uint32_t maxUs;       // Longest latency in microseconds.
+  uint64_t sumUs;       // Sum of latencies in microseconds.
+  uint64_t sumSquares;  // Sum of squared latencies, for the standard deviation.
+};
+
+class CommandQueue {
+public:
+  /**
+  * Constructs a CommandQueue object.
+  * Call begin() before pushing commands.
+  */
+  CommandQueue();
+
+  /**
+  * Creates the underlying FreeRTOS queue.
+  *
+  * @return true if the queue was created; false otherwise.
+  */
+  bool begin();
+
+  /**
+  * Pushes a valve command without blocking.
+  * Safe to call from the MQTT callback and the local endpoint.
+  *
+  * @param open True to open the valve, false to close it.
+  * @return true if the command was queued; false if it was dropped.
+  */
+  bool pushValve(bool open);
+
+  /**
+  * Pushes a full parameter set without blocking.
+  * Safe to call from the MQTT callback and the local endpoint.
+  *
+  * @param params The new controller parameters.
+  * @return true if the command was queued; false if it was dropped.
+  */
+  bool pushParams(const WateringParams& params);
+
+  /**
+  * Drains the queue and applies commands to the controller.
+  * Must be called from the task that owns the valve. Waits up to the given time for the first command.
+  * Only the latest valve command is kept, and it is applied once the valve has dwelled long enough.
+  * Only the latest parameter set of a burst is applied, and it is saved once.
+  *
+  * @param controller The controller that owns the valve.
+  * @param wait Maximum time to wait for a command in ticks.
+  * @return true if at least one command was received; false otherwise.
+  */
+  bool process(WateringController& controller, TickType_t wait);
+
+  /**
+  * Returns the command counters.
+  * Safe to call from any task.
+  *
+  * @return Copy of the command counters.
+  */
+  CommandQueueStats stats() const;
+
+  /**
+  * Records the command-to-valve latency after the controller switched the valve.
+  * Must be called from the task that owns the valve, right after the valve output changed.
+  * Does nothing unless the switch was caused by a command applied in the last call to process().
+  */
+  void valveSwitched();
+
+  /**
+  * Returns the command-to-valve latency statistics.
+  * Safe to call from any task.
+  *
+  * @return Copy of the latency statistics.
+  */
+  CommandLatencyStats latency() const;
+
+private:
+  bool send(const ControlCommand& command);
+  void count(uint32_t& counter);
+  void receive(const ControlCommand& command, WateringController& controller);
+
+  QueueHandle_t _queue;
+  bool _hasPending;
+  bool _pendingOpen;
+  bool _pendingHeld;          // Pending command was held back by the dwell time.
+  bool _hasParams;            // A parameter set was received in the current call to process().
+  WateringParams _params;     // Latest parameter set received in the current call to process().
+  uint32_t _pendingQueuedAt;  // Queue time of the pending command.
+  bool _latencyPending;       // A command was applied and its valve switch is not measured yet.
+  uint32_t _latencyQueuedAt;  // Queue time of the applied command.
+  CommandQueueStats _stats;
+  CommandLatencyStats _latency;
+  mutable portMUX_TYPE _latencyLock;
+  mutable portMUX_TYPE _statsLock;
+};
+
+#endif
@@ -0,0 +1,92 @@
+/**
+* CommandTracker.cpp
+* Implementation of the command deduplication window.
+*
+* This file contains the implementation for the CommandTracker class.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+#include "CommandTracker.h"
+
+/**
+* Constructs an empty CommandTracker object.
+*/
+CommandTracker::CommandTracker()
+  : _next(0),
+    _count(0),
+    _duplicates(0) {
+  memset(_window, 0, sizeof(_window));
+}
+
+/**
+* Checks whether a command identifier is in the window.
+* Every hit is counted as a duplicate delivery.
+*
+* @param id The command identifier.
+* @return true if the identifier was already remembered; false otherwise.
+*/
+bool CommandTracker::seen(const char* id) {
+  uint32_t value = hash(id);
+
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_window[i] == value) {
+      _duplicates++;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+* Remembers a command identifier once the command has been applied or queued.
+* Commands that were refused are not remembered, so a retry with the same identifier is applied.
+* Identifiers are stored as 32-bit hashes, the oldest entry is replaced when the window is full.
+*
+* @param id The command identifier.
+*/
+void CommandTracker::remember(const char* id) {
+  _window[_next] = hash(id);
+  _next = (_next + 1) % COMMAND_WINDOW_SIZE;
+  _count = min<uint8_t>(_count + 1, COMMAND_WINDOW_SIZE);
+}
+
+/**
+* Returns the number of duplicate deliveries recognized since boot.
+*
+* @return Number of duplicate deliveries.
+*/
+uint32_t CommandTracker::duplicates() const {
+  return _duplicates;
+}
+
+uint32_t CommandTracker::hash(const char* id) {
+  // FNV-1a.
+  uint32_t value = 2166136261UL;
+
+  while (*id != '\0') {
+    value = (value ^ (uint8_t)*id++) * 16777619UL;
+  }
+
+  return value;
+}
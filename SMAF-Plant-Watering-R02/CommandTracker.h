@@ -0,0 +1,80 @@
+/**
+* CommandTracker.h
+* Declaration of the command deduplication window.
+*
+* This file contains the declaration for the CommandTracker class, which remembers the identifiers
+* of the most recently applied broker commands. With QoS 1 and persistent sessions the broker may
+* deliver the same command more than once; repeated deliveries are recognized here and turned into
+* cheap no-ops that are only acknowledged again.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef COMMAND_TRACKER_H
+#define COMMAND_TRACKER_H
+
+#include "Arduino.h"
+
+// Number of recent command identifiers remembered.
+#define COMMAND_WINDOW_SIZE 32
+
+class CommandTracker {
+public:
+  /**
+  * Constructs an empty CommandTracker object.
+  */
+  CommandTracker();
+
+  /**
+  * Checks whether a command identifier is in the window.
+  * Every hit is counted as a duplicate delivery.
+  *
+  * @param id The command identifier.
+  * @return true if the identifier was already remembered; false otherwise.
+  */
+  bool seen(const char* id);
+
+  /**
+  * Remembers a command identifier once the command has been applied or queued.
+  * Commands that were refused are not remembered, so a retry with the same identifier is applied.
+  * Identifiers are stored as 32-bit hashes, the oldest entry is replaced when the window is full.
+  *
+  * @param id The command identifier.
+  */
+  void remember(const char* id);
+
+  /**
+  * Returns the number of duplicate deliveries recognized since boot.
+  *
+  * @return Number of duplicate deliveries.
+  */
+  uint32_t duplicates() const;
+
+private:
+  static uint32_t hash(const char* id);
+
+  uint32_t _window[COMMAND_WINDOW_SIZE];
+  uint8_t _next;
+  uint8_t _count;
+  uint32_t _duplicates;
+};
+
+#endif
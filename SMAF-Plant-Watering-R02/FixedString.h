@@ -0,0 +1,164 @@
+/**
+* FixedString.h
+* Declaration of a fixed-capacity string.
+*
+* This file contains the FixedString class template, a string stored inline in a buffer of a
+* capacity fixed at compile time. It never allocates, so configuration values and MQTT topics can
+* live for the lifetime of the device without touching the heap. Every write is length-checked: a
+* value that does not fit is rejected and the previous content is kept.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include "Arduino.h"
+#include <stdarg.h>
+
+template <size_t Capacity>
+class FixedString {
+public:
+  /**
+  * Constructs an empty FixedString object.
+  */
+  FixedString();
+
+  /**
+  * Replaces the content with a C-string.
+  *
+  * @param str The C-string to copy, NULL is treated as empty.
+  * @return false if the string is longer than the capacity; true otherwise.
+  */
+  bool assign(const char* str);
+
+  /**
+  * Replaces the content with a formatted string.
+  *
+  * @param format The printf format string.
+  * @param ... Additional arguments for formatting.
+  * @return false if the result is longer than the capacity; true otherwise.
+  */
+  bool format(const char* format, ...);
+
+  /**
+  * Clears the content.
+  */
+  void clear();
+
+  /**
+  * Returns the content as a zero terminated C-string.
+  *
+  * @return Pointer to the internal buffer, valid for the lifetime of the object.
+  */
+  const char* c_str() const;
+
+  /**
+  * Returns the length of the content, excluding the terminator.
+  *
+  * @return The length in bytes.
+  */
+  size_t length() const;
+
+  /**
+  * Returns the maximum length of the content, excluding the terminator.
+  *
+  * @return The capacity in bytes.
+  */
+  size_t capacity() const;
+
+  /**
+  * Checks if the content is empty.
+  *
+  * @return true if the string is empty; false otherwise.
+  */
+  bool isEmpty() const;
+
+private:
+  char _buffer[Capacity + 1];
+  size_t _length;
+};
+
+template <size_t Capacity>
+FixedString<Capacity>::FixedString()
+  : _length(0) {
+  _buffer[0] = 0;
+}
+
+template <size_t Capacity>
+bool FixedString<Capacity>::assign(const char* str) {
+  size_t length = str != NULL ? strnlen(str, Capacity + 1) : 0;
+
+  if (length > Capacity) {
+    return false;
+  }
+
+  memcpy(_buffer, str, length);
+  _buffer[length] = 0;
+  _length = length;
+  return true;
+}
+
+template <size_t Capacity>
+bool FixedString<Capacity>::format(const char* format, ...) {
+  char buffer[Capacity + 1];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+
+  // Format into a scratch buffer first, so a result that does not fit leaves the content intact.
+  if (length < 0 || (size_t)length > Capacity) {
+    return false;
+  }
+
+  memcpy(_buffer, buffer, length + 1);
+  _length = length;
+  return true;
+}
+
+template <size_t Capacity>
+void FixedString<Capacity>::clear() {
+  _buffer[0] = 0;
+  _length = 0;
+}
+
+template <size_t Capacity>
+const char* FixedString<Capacity>::c_str() const {
+  return _buffer;
+}
+
+template <size_t Capacity>
+size_t FixedString<Capacity>::length() const {
+  return _length;
+}
+
+template <size_t Capacity>
+size_t FixedString<Capacity>::capacity() const {
+  return Capacity;
+}
+
+template <size_t Capacity>
+bool FixedString<Capacity>::isEmpty() const {
+  return _length == 0;
+}
+
+#endif
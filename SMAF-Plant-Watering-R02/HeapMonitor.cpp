@@ -0,0 +1,107 @@
+/**
+* HeapMonitor.cpp
+* Implementation of the heap allocation and fragmentation monitor.
+*
+* This file contains the implementation for the HeapMonitor class and the optional heap hooks.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+#include "HeapMonitor.h"
+#include "esp_heap_caps.h"
+
+// Allocations seen by the heap hooks, from any task or interrupt.
+static volatile uint32_t heapAllocations = 0;
+
+#ifdef CONFIG_HEAP_USE_HOOKS
+/**
+* Called by ESP-IDF on every successful allocation.
+*/
+void IRAM_ATTR esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) {
+  __atomic_add_fetch(&heapAllocations, 1, __ATOMIC_RELAXED);
+}
+
+/**
+* Called by ESP-IDF on every free.
+*/
+void IRAM_ATTR esp_heap_trace_free_hook(void* ptr) {
+}
+#endif
+
+/**
+* Constructs a HeapMonitor object.
+*/
+HeapMonitor::HeapMonitor()
+  : _steady(false), _baseBlocks(0), _baseAllocations(0) {
+}
+
+/**
+* Takes the steady state snapshot. Only the first call has an effect.
+*/
+void HeapMonitor::markSteadyState() {
+  if (_steady) {
+    return;
+  }
+
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+
+  _baseBlocks = info.allocated_blocks;
+  _baseAllocations = __atomic_load_n(&heapAllocations, __ATOMIC_RELAXED);
+  _steady = true;
+}
+
+/**
+* Checks if the steady state snapshot was taken.
+*
+* @return true if markSteadyState() was called; false otherwise.
+*/
+bool HeapMonitor::isSteadyState() const {
+  return _steady;
+}
+
+/**
+* Samples the heap of the default (8-bit capable) memory.
+*
+* @return The current heap sample.
+*/
+HeapStats HeapMonitor::sample() const {
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+
+  HeapStats stats = {};
+  stats.freeBytes = info.total_free_bytes;
+  stats.largestFreeBlock = info.largest_free_block;
+  stats.minimumFreeBytes = info.minimum_free_bytes;
+  stats.allocatedBlocks = info.allocated_blocks;
+  stats.blockDrift = _steady ? (int32_t)(info.allocated_blocks - _baseBlocks) : 0;
+
+  // A heap that is free but scattered over small blocks cannot serve large requests.
+  stats.fragmentation = info.total_free_bytes > 0 ? 100 - (uint8_t)((uint64_t)info.largest_free_block * 100 / info.total_free_bytes) : 0;
+
+#ifdef CONFIG_HEAP_USE_HOOKS
+  stats.countsAllocations = true;
+  stats.allocations = _steady ? __atomic_load_n(&heapAllocations, __ATOMIC_RELAXED) - _baseAllocations : 0;
+#endif
+
+  return stats;
+}
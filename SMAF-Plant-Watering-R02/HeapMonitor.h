@@ -0,0 +1,84 @@
+/**
+* HeapMonitor.h
+* Declaration of the heap allocation and fragmentation monitor.
+*
+* This file contains the declaration for the HeapMonitor class. Once the firmware reaches its steady
+* state (connected and publishing), the monitor takes a snapshot of the heap. Later samples report
+* how many blocks were allocated since then and how fragmented the free heap is, so long runs show
+* whether the steady state allocates or leaks.
+*
+* When ESP-IDF is built with CONFIG_HEAP_USE_HOOKS, every allocation is also counted. Without the
+* hooks the allocated block count, which must return to its snapshot value between publishes, is
+* the allocation metric.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include "Arduino.h"
+
+// Struct to hold a heap sample.
+struct HeapStats {
+  uint32_t freeBytes;         // Free heap in bytes.
+  uint32_t largestFreeBlock;  // Largest allocatable block in bytes.
+  uint32_t minimumFreeBytes;  // Lowest free heap since boot in bytes.
+  uint32_t allocatedBlocks;   // Blocks currently allocated.
+  int32_t blockDrift;         // Allocated blocks relative to the steady state snapshot.
+  uint8_t fragmentation;      // Free heap not usable as one block, in percent.
+  bool countsAllocations;     // Whether allocations is maintained by the heap hooks.
+  uint32_t allocations;       // Allocations since the steady state snapshot.
+};
+
+class HeapMonitor {
+public:
+  /**
+  * Constructs a HeapMonitor object.
+  */
+  HeapMonitor();
+
+  /**
+  * Takes the steady state snapshot. Only the first call has an effect.
+  */
+  void markSteadyState();
+
+  /**
+  * Checks if the steady state snapshot was taken.
+  *
+  * @return true if markSteadyState() was called; false otherwise.
+  */
+  bool isSteadyState() const;
+
+  /**
+  * Samples the heap of the default (8-bit capable) memory.
+  *
+  * @return The current heap sample.
+  */
+  HeapStats sample() const;
+
+private:
+  bool _steady;
+  uint32_t _baseBlocks;
+  uint32_t _baseAllocations;
+};
+
+#endif
@@ -41,8 +41,8 @@ MessageTypeEnum messageType = LOG;
 * @param ... Additional arguments for formatting the message.
 */
 void debug(MessageTypeEnum messageType, const char* format, ...) {
-  // Set up an empty string to store the message type as a string
-  String messageTypeStr;
+  // Point to a constant message type string, so logging does not allocate.
+  const char* messageTypeStr = "LOG";
 
   // Switch statement to determine the message type string based on the input byte
   switch (messageType) {
@@ -68,7 +68,10 @@ void debug(MessageTypeEnum messageType, const char* format, ...) {
   va_end(args);
 
   // Print the formatted debug message to the Serial monitor.
-  Serial.printf("CORE-%02d | %5s | %s\n\r", xPortGetCoreID(), messageTypeStr.c_str(), buffer);
+  // The line is assembled on the stack, Serial.printf() would allocate for lines over 64 bytes.
+  char line[sizeof(buffer) + 24];
+  int length = snprintf(line, sizeof(line), "CORE-%02d | %5s | %s\n\r", xPortGetCoreID(), messageTypeStr, buffer);
+  Serial.write((const uint8_t*)line, min<size_t>(max(length, 0), sizeof(line) - 1));
 }
 
 /**
@@ -147,4 +150,37 @@ bool isEmpty(const char* str) {
 */
 String quotation(String data) {
   return "\"" + data + "\"";
-}
\ No newline at end of file
+}
+
+/**
+* Retrieves the current UTC time as a formatted string.
+* This function formats the system time as a UTC date time string (e.g., "2024-06-20T20:56:59Z").
+* 
+* @return A String containing the current UTC time, or "Unknown" if the time cannot be retrieved.
+*/
+String getUtcTimeString() {
+  // Create a buffer to hold the formatted time string
+  char buffer[UTC_TIME_LENGTH];
+  formatUtcTime(buffer, sizeof(buffer));
+  return String(buffer);
+}
+
+/**
+* Formats the current UTC time into a caller provided buffer.
+* This function writes the same format as getUtcTimeString() without allocating.
+* 
+* @param buffer The buffer to write to, at least UTC_TIME_LENGTH bytes.
+* @param size The size of the buffer.
+* @return false if the time cannot be retrieved and "Unknown" was written; true otherwise.
+*/
+bool formatUtcTime(char* buffer, size_t size) {
+  struct tm timeinfo;
+
+  if (!getLocalTime(&timeinfo)) {
+    snprintf(buffer, size, "Unknown");
+    return false;
+  }
+
+  strftime(buffer, size, "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+  return true;
+}
@@ -32,6 +32,9 @@
 #include "esp_task_wdt.h"
 #include "esp_system.h"
 
+// Size of a UTC time string buffer, "2024-06-20T20:56:59Z" plus the terminator.
+#define UTC_TIME_LENGTH 21
+
 // Define a macro for comparing version numbers.
 #define VERSION_CHECK(major, minor, patch) ((major)*10000 + (minor)*100 + (patch))
 
@@ -97,4 +100,22 @@ bool isEmpty(const char* str);
 */
 String quotation(String data);
 
+/**
+* Retrieves the current UTC time as a formatted string.
+* This function formats the system time as a UTC date time string (e.g., "2024-06-20T20:56:59Z").
+* 
+* @return A String containing the current UTC time, or "Unknown" if the time cannot be retrieved.
+*/
+String getUtcTimeString();
+
+/**
+* Formats the current UTC time into a caller provided buffer.
+* This function writes the same format as getUtcTimeString() without allocating.
+* 
+* @param buffer The buffer to write to, at least UTC_TIME_LENGTH bytes.
+* @param size The size of the buffer.
+* @return false if the time cannot be retrieved and "Unknown" was written; true otherwise.
+*/
+bool formatUtcTime(char* buffer, size_t size);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,165 @@
+/**
+* JsonArena.cpp
+* Implementation of a static memory arena for ArduinoJson documents.
+*
+* This file contains the implementation for the JsonArena class.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+#include "JsonArena.h"
+
+// Every block starts with a header holding its size, blocks are aligned for any scalar type.
+#define JSON_ARENA_ALIGNMENT 8
+#define JSON_ARENA_HEADER JSON_ARENA_ALIGNMENT
+
+static size_t alignSize(size_t size) {
+  return (size + JSON_ARENA_ALIGNMENT - 1) & ~(size_t)(JSON_ARENA_ALIGNMENT - 1);
+}
+
+/**
+* Constructs a JsonArena object.
+*
+* @param buffer Memory backing the arena, must outlive every document using it.
+* @param size Size of the buffer in bytes.
+*/
+JsonArena::JsonArena(uint8_t* buffer, size_t size)
+  : _buffer(buffer), _size(size), _used(0), _last(size), _live(0), _stats{} {
+}
+
+/**
+* Allocates a block from the arena, or from the heap when the arena is full.
+*
+* @param size Requested size in bytes.
+* @return Pointer to the block, or NULL if neither the arena nor the heap has room.
+*/
+void* JsonArena::allocate(size_t size) {
+  size_t total = JSON_ARENA_HEADER + alignSize(size);
+
+  if (total > _size - _used) {
+    _stats.fallbacks++;
+    return malloc(size);
+  }
+
+  uint8_t* block = _buffer + _used;
+  *(size_t*)block = alignSize(size);
+
+  _last = _used;
+  _used += total;
+  _live++;
+
+  if (_used > _stats.peak) {
+    _stats.peak = _used;
+  }
+
+  return block + JSON_ARENA_HEADER;
+}
+
+/**
+* Releases a block. The arena is reset once no block is in use.
+*
+* @param ptr Pointer returned by allocate() or reallocate().
+*/
+void JsonArena::deallocate(void* ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+
+  if (!owns(ptr)) {
+    free(ptr);
+    return;
+  }
+
+  _live--;
+
+  if (_live == 0) {
+    // Every document using the arena is gone, start over.
+    _used = 0;
+    _last = _size;
+  } else if ((uint8_t*)ptr == _buffer + _last + JSON_ARENA_HEADER) {
+    // The most recent block can be handed back directly, older ones are reclaimed on reset.
+    _used = _last;
+    _last = _size;
+  }
+}
+
+/**
+* Resizes a block, in place when it is the most recent arena block.
+*
+* @param ptr Pointer returned by allocate() or reallocate(), or NULL.
+* @param size New size in bytes.
+* @return Pointer to the resized block, or NULL on failure.
+*/
+void* JsonArena::reallocate(void* ptr, size_t size) {
+  if (ptr == NULL) {
+    return allocate(size);
+  }
+
+  if (!owns(ptr)) {
+    _stats.fallbacks++;
+    return realloc(ptr, size);
+  }
+
+  size_t current = blockSize(ptr);
+
+  // Grow or shrink the most recent block where it is.
+  if ((uint8_t*)ptr == _buffer + _last + JSON_ARENA_HEADER && JSON_ARENA_HEADER + alignSize(size) <= _size - _last) {
+    *(size_t*)(_buffer + _last) = alignSize(size);
+    _used = _last + JSON_ARENA_HEADER + alignSize(size);
+
+    if (_used > _stats.peak) {
+      _stats.peak = _used;
+    }
+
+    return ptr;
+  }
+
+  if (size <= current) {
+    return ptr;
+  }
+
+  void* moved = allocate(size);
+  if (moved == NULL) {
+    return NULL;
+  }
+
+  memcpy(moved, ptr, current);
+  deallocate(ptr);
+  return moved;
+}
+
+/**
+* Returns the arena counters.
+*
+* @return The peak usage and the number of heap fallbacks.
+*/
+JsonArenaStats JsonArena::stats() const {
+  return _stats;
+}
+
+bool JsonArena::owns(const void* ptr) const {
+  return (const uint8_t*)ptr >= _buffer && (const uint8_t*)ptr < _buffer + _size;
+}
+
+size_t JsonArena::blockSize(const void* ptr) const {
+  return *(const size_t*)((const uint8_t*)ptr - JSON_ARENA_HEADER);
+}
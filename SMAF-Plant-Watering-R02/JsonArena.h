@@ -0,0 +1,100 @@
+/**
+* JsonArena.h
+* Declaration of a static memory arena for ArduinoJson documents.
+*
+* This file contains the declaration for the JsonArena class, an ArduinoJson allocator that hands
+* out memory from a fixed buffer instead of the heap. Documents are short-lived: they are built,
+* serialized and destroyed within one publish or one MQTT callback. The arena therefore only bumps
+* an offset, gives back the most recent block in place and starts over when the last live block is
+* released. Requests that do not fit fall back to the heap and are counted, so the arena size can be
+* tuned from the status payload.
+*
+* The arena is not thread-safe. Use one arena per task.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include "Arduino.h"
+#include "ArduinoJson.h"
+
+// Struct to hold the arena counters.
+struct JsonArenaStats {
+  uint32_t peak;       // Highest number of arena bytes in use at the same time.
+  uint32_t fallbacks;  // Allocations served by the heap because the arena was full.
+};
+
+class JsonArena : public ArduinoJson::Allocator {
+public:
+  /**
+  * Constructs a JsonArena object.
+  *
+  * @param buffer Memory backing the arena, must outlive every document using it.
+  * @param size Size of the buffer in bytes.
+  */
+  JsonArena(uint8_t* buffer, size_t size);
+
+  /**
+  * Allocates a block from the arena, or from the heap when the arena is full.
+  *
+  * @param size Requested size in bytes.
+  * @return Pointer to the block, or NULL if neither the arena nor the heap has room.
+  */
+  void* allocate(size_t size) override;
+
+  /**
+  * Releases a block. The arena is reset once no block is in use.
+  *
+  * @param ptr Pointer returned by allocate() or reallocate().
+  */
+  void deallocate(void* ptr) override;
+
+  /**
+  * Resizes a block, in place when it is the most recent arena block.
+  *
+  * @param ptr Pointer returned by allocate() or reallocate(), or NULL.
+  * @param size New size in bytes.
+  * @return Pointer to the resized block, or NULL on failure.
+  */
+  void* reallocate(void* ptr, size_t size) override;
+
+  /**
+  * Returns the arena counters.
+  *
+  * @return The peak usage and the number of heap fallbacks.
+  */
+  JsonArenaStats stats() const;
+
+private:
+  bool owns(const void* ptr) const;
+  size_t blockSize(const void* ptr) const;
+
+  uint8_t* _buffer;
+  size_t _size;
+  size_t _used;        // Offset of the first free byte.
+  size_t _last;        // Offset of the most recent block header, or _size if it was released.
+  uint32_t _live;      // Arena blocks in use.
+  JsonArenaStats _stats;
+};
+
+#endif
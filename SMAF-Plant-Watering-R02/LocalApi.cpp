@@ -0,0 +1,431 @@
+/**
+* LocalApi.cpp
+* Implementation of the local status and control endpoint.
+*
+* This file contains the implementation of the LocalApi class, which pushes status, metrics and
+* events to local WebSocket clients and forwards their watering commands to the command queue.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+#include "LocalApi.h"
+#include "Payload.h"
+#include "Helpers.h"
+
+/**
+* Constructs a LocalApi object.
+*
+* @param port TCP port of the endpoint.
+*/
+LocalApi::LocalApi(uint16_t port)
+  : _server(port),
+    _ws("/live"),
+    _token(NULL),
+    _commands(NULL),
+    _lock(NULL),
+    _clients{},
+    _stats{},
+    _statusLength(0),
+    _statusVersion(0),
+    _metricsLength(0),
+    _metricsVersion(0),
+    _eventLengths{},
+    _eventCount(0),
+    _requestArena(_requestBuffer, sizeof(_requestBuffer)) {
+}
+
+/**
+* Starts the web server. Call once the network interface is up.
+*
+* @param token Token clients authenticate with, must outlive the endpoint.
+* @param commands Queue that watering commands are pushed to.
+* @return true if the endpoint was started; false if the token is empty or the lock could not be created.
+*/
+bool LocalApi::begin(const char* token, CommandQueue& commands) {
+  if (isRunning() || token == NULL || isEmpty(token)) {
+    return false;
+  }
+
+  // Recursive, because closing a client from update() can fire its disconnect event right away.
+  _lock = xSemaphoreCreateRecursiveMutex();
+  if (_lock == NULL) {
+    return false;
+  }
+
+  _token = token;
+  _commands = &commands;
+
+  _ws.onEvent([this](AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len) {
+    handleEvent(client, type, arg, data, len);
+  });
+
+  _server.addHandler(&_ws);
+  _server.begin();
+  return true;
+}
+
+/**
+* Checks if the endpoint was started.
+*
+* @return true if begin() succeeded; false otherwise.
+*/
+bool LocalApi::isRunning() const {
+  return _lock != NULL;
+}
+
+/**
+* Replaces the status snapshot. Must be called from the task that calls update().
+*
+* @param doc The status document.
+*/
+void LocalApi::publishStatus(const JsonDocument& doc) {
+  char message[LOCAL_API_STATUS_SIZE];
+  size_t length = serializePayload(doc, PAYLOAD_JSON, (uint8_t*)message, sizeof(message));
+
+  // Clients only need a new version when the content changed.
+  if (length == 0 || (length == _statusLength && memcmp(message, _status, length) == 0)) {
+    return;
+  }
+
+  memcpy(_status, message, length);
+  _statusLength = length;
+  _statusVersion++;
+}
+
+/**
+* Replaces the metrics snapshot. Must be called from the task that calls update().
+*
+* @param doc The metrics document.
+*/
+void LocalApi::publishMetrics(const JsonDocument& doc) {
+  char message[LOCAL_API_METRICS_SIZE];
+  size_t length = serializePayload(doc, PAYLOAD_JSON, (uint8_t*)message, sizeof(message));
+
+  if (length == 0 || (length == _metricsLength && memcmp(message, _metrics, length) == 0)) {
+    return;
+  }
+
+  memcpy(_metrics, message, length);
+  _metricsLength = length;
+  _metricsVersion++;
+}
+
+/**
+* Adds an event to the ring. Must be called from the task that calls update().
+*
+* @param doc The event document.
+*/
+void LocalApi::publishEvent(const JsonDocument& doc) {
+  uint32_t slot = _eventCount % LOCAL_API_EVENT_DEPTH;
+  size_t length = serializePayload(doc, PAYLOAD_JSON, (uint8_t*)_events[slot], LOCAL_API_EVENT_SIZE);
+
+  if (length > 0) {
+    _eventLengths[slot] = length;
+    _eventCount++;
+  }
+}
+
+/**
+* Sends pending snapshots and events to every client with room in its queue and closes clients
+* that did not authenticate in time or stayed blocked. Never waits for a client.
+*
+* @param now Current time in milliseconds.
+*/
+void LocalApi::update(uint32_t now) {
+  if (!isRunning()) {
+    return;
+  }
+
+  // The lock is held while clients are used, so a disconnect cannot free a client in between.
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+  for (size_t i = 0; i < LOCAL_API_MAX_CLIENTS; i++) {
+    Client& slot = _clients[i];
+
+    if (slot.id != 0 && !slot.authenticated && now - slot.connectedAt >= LOCAL_API_AUTH_TIMEOUT) {
+      AsyncWebSocketClient* client = slot.client;
+      _stats.authFailures++;
+      slot = {};
+      client->close();
+      continue;
+    }
+
+    if (slot.id == 0 || !slot.authenticated || slot.client->status() != WS_CONNECTED) {
+      continue;
+    }
+
+    // New clients receive the current snapshots and only events published after they joined.
+    if (slot.fresh) {
+      slot.nextEvent = _eventCount;
+      slot.fresh = false;
+    }
+
+    if (slot.resend) {
+      slot.statusSent = 0;
+      slot.metricsSent = 0;
+      slot.resend = false;
+    }
+
+    if (!pump(slot)) {
+      slot.blockedSince = 0;
+    } else if (slot.blockedSince == 0) {
+      slot.blockedSince = now | 1;  // Zero means not blocked.
+    } else if (now - slot.blockedSince >= LOCAL_API_STALL_TIMEOUT && slot.client != NULL) {
+      _stats.stalled++;
+      slot.client->close();
+    }
+  }
+  xSemaphoreGiveRecursive(_lock);
+}
+
+/**
+* Returns the endpoint counters.
+* Safe to call from any task.
+*
+* @return Copy of the endpoint counters.
+*/
+LocalApiStats LocalApi::stats() const {
+  if (!isRunning()) {
+    return _stats;
+  }
+
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+  LocalApiStats copy = _stats;
+  copy.jsonFallbacks = _requestArena.stats().fallbacks;
+  copy.clients = 0;
+  for (size_t i = 0; i < LOCAL_API_MAX_CLIENTS; i++) {
+    if (_clients[i].id != 0 && _clients[i].authenticated) {
+      copy.clients++;
+    }
+  }
+  xSemaphoreGiveRecursive(_lock);
+
+  return copy;
+}
+
+void LocalApi::handleEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len) {
+  switch (type) {
+    case WS_EVT_CONNECT:
+      connect(client);
+      break;
+    case WS_EVT_DISCONNECT:
+      disconnect(client);
+      break;
+    case WS_EVT_DATA:
+      {
+        // Requests are small, fragmented and binary frames are not accepted.
+        AwsFrameInfo* info = (AwsFrameInfo*)arg;
+        if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
+          receive(client, data, len);
+        } else {
+          reply(client, "error", "", "invalid");
+        }
+        break;
+      }
+    default:
+      break;
+  }
+}
+
+void LocalApi::connect(AsyncWebSocketClient* client) {
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+  Client* slot = find(0);
+  if (slot != NULL) {
+    *slot = {};
+    slot->id = client->id();
+    slot->client = client;
+    slot->connectedAt = millis();
+    slot->fresh = true;
+  }
+  xSemaphoreGiveRecursive(_lock);
+
+  if (slot == NULL) {
+    client->close();
+  }
+}
+
+void LocalApi::disconnect(AsyncWebSocketClient* client) {
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+  Client* slot = find(client->id());
+  if (slot != NULL) {
+    *slot = {};
+  }
+  xSemaphoreGiveRecursive(_lock);
+}
+
+void LocalApi::receive(AsyncWebSocketClient* client, const uint8_t* data, size_t len) {
+  JsonDocument doc(&_requestArena);
+  if (len > LOCAL_API_REQUEST_SIZE || deserializeJson(doc, (const char*)data, len)) {
+    reply(client, "error", "", "invalid");
+    return;
+  }
+
+  const char* action = doc["action"] | "";
+  const char* id = doc["id"] | "";
+
+  if (strcmp(action, "auth") == 0) {
+    bool accepted = checkToken(doc["token"] | "");
+
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    Client* slot = find(client->id());
+    if (slot != NULL) {
+      slot->authenticated = accepted;
+    }
+    if (!accepted) {
+      _stats.authFailures++;
+    }
+    xSemaphoreGiveRecursive(_lock);
+
+    reply(client, "auth", id, accepted ? "ok" : "denied");
+    if (!accepted) {
+      client->close();
+    }
+    return;
+  }
+
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+  Client* slot = find(client->id());
+  bool authenticated = slot != NULL && slot->authenticated;
+  if (!authenticated) {
+    _stats.authFailures++;
+  } else if (strcmp(action, "get") == 0) {
+    slot->resend = true;
+  }
+  xSemaphoreGiveRecursive(_lock);
+
+  if (!authenticated) {
+    reply(client, "ack", id, "unauthorized");
+    client->close();
+  } else if (strcmp(action, "watering") == 0 && doc["watering"].is<bool>()) {
+    // The control task picks the command up right away, no other task is involved.
+    bool queued = _commands->pushValve(doc["watering"]);
+
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    _stats.commands++;
+    xSemaphoreGiveRecursive(_lock);
+
+    reply(client, "ack", id, queued ? "accepted" : "dropped");
+  } else if (strcmp(action, "get") != 0) {
+    reply(client, "ack", id, "rejected");
+  }
+}
+
+void LocalApi::reply(AsyncWebSocketClient* client, const char* type, const char* id, const char* status) {
+  JsonDocument doc(&_requestArena);
+  constructAckPayload(doc, id, status);
+  doc["type"] = type;
+
+  char message[LOCAL_API_REQUEST_SIZE + 64];
+  size_t length = serializePayload(doc, PAYLOAD_JSON, (uint8_t*)message, sizeof(message));
+  // Sends from both tasks are serialized by the lock.
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+  bool sent = length > 0 && send(client, message, length);
+  if (sent) {
+    _stats.sent++;
+  } else {
+    _stats.dropped++;
+  }
+  xSemaphoreGiveRecursive(_lock);
+}
+
+bool LocalApi::send(AsyncWebSocketClient* client, const char* message, size_t length) {
+  if (client->queueIsFull() || client->queueLen() >= LOCAL_API_CLIENT_QUEUE) {
+    return false;
+  }
+
+  client->text(message, length);
+  return true;
+}
+
+// Sends until the client is up to date or its queue is full, returns true in the latter case.
+// A client the library drops while sending is cleared from its slot by disconnect().
+bool LocalApi::pump(Client& state) {
+  while (state.client != NULL) {
+    bool pendingEvent = state.nextEvent != _eventCount;
+    bool pendingStatus = state.statusSent != _statusVersion;
+    bool pendingMetrics = state.metricsSent != _metricsVersion;
+
+    if (!pendingEvent && !pendingStatus && !pendingMetrics) {
+      return false;
+    }
+
+    // Events go first, they are the only messages that cannot be replaced by a newer one.
+    if (pendingEvent) {
+      if (_eventCount - state.nextEvent > LOCAL_API_EVENT_DEPTH) {
+        _stats.dropped += _eventCount - state.nextEvent - LOCAL_API_EVENT_DEPTH;
+        state.nextEvent = _eventCount - LOCAL_API_EVENT_DEPTH;
+      }
+
+      uint32_t slot = state.nextEvent % LOCAL_API_EVENT_DEPTH;
+      if (!send(state.client, _events[slot], _eventLengths[slot])) {
+        return true;
+      }
+
+      state.nextEvent++;
+    } else if (pendingStatus) {
+      if (!send(state.client, _status, _statusLength)) {
+        return true;
+      }
+
+      // Versions published while the client was blocked were never sent.
+      if (state.statusSent != 0) {
+        _stats.coalesced += _statusVersion - state.statusSent - 1;
+      }
+      state.statusSent = _statusVersion;
+    } else {
+      if (!send(state.client, _metrics, _metricsLength)) {
+        return true;
+      }
+
+      if (state.metricsSent != 0) {
+        _stats.coalesced += _metricsVersion - state.metricsSent - 1;
+      }
+      state.metricsSent = _metricsVersion;
+    }
+
+    _stats.sent++;
+  }
+
+  return false;
+}
+
+LocalApi::Client* LocalApi::find(uint32_t id) {
+  for (size_t i = 0; i < LOCAL_API_MAX_CLIENTS; i++) {
+    if (_clients[i].id == id) {
+      return &_clients[i];
+    }
+  }
+
+  return NULL;
+}
+
+// Compares in constant time, so the response time does not reveal how much of the token matched.
+bool LocalApi::checkToken(const char* token) const {
+  size_t expected = strlen(_token);
+  size_t given = strnlen(token, LOCAL_API_REQUEST_SIZE);
+  uint8_t diff = expected != given;
+
+  for (size_t i = 0; i < expected; i++) {
+    diff |= _token[i] ^ (i < given ? token[i] : 0);
+  }
+
+  return diff == 0;
+}
@@ -0,0 +1,198 @@
+/**
+* LocalApi.h
+* Declaration of the local status and control endpoint.
+*
+* This file contains the declaration of the LocalApi class, a WebSocket endpoint on the LAN that
+* pushes status, metrics and watering events to local clients and accepts authenticated watering
+* commands. Clients first send {"action":"auth","token":"..."} with the token set in the portal.
+*
+* Status and metrics are snapshots: a client that cannot keep up only receives the latest one.
+* Events are kept in a short ring, a client that falls further behind skips the oldest ones. A
+* message is only handed to the WebSocket library while fewer than LOCAL_API_CLIENT_QUEUE messages
+* wait for that client, so a slow client costs a bounded amount of memory and never blocks the
+* caller. Clients that stay blocked for LOCAL_API_STALL_TIMEOUT are closed.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef LOCAL_API_H
+#define LOCAL_API_H
+
+#include "Arduino.h"
+#include "ArduinoJson.h"
+#include "CommandQueue.h"
+#include "JsonArena.h"
+#include <ESPAsyncWebServer.h>
+
+// TCP port of the endpoint, the setup portal is not running in operational mode.
+#define LOCAL_API_PORT 80
+
+// Maximum number of connected local clients.
+#define LOCAL_API_MAX_CLIENTS 4
+
+// Messages that may wait in the WebSocket queue of one client.
+#define LOCAL_API_CLIENT_QUEUE 4
+
+// Number of recent events kept for clients that are behind.
+#define LOCAL_API_EVENT_DEPTH 4
+
+// Largest status, metrics and event message in bytes.
+#define LOCAL_API_STATUS_SIZE 192
+#define LOCAL_API_METRICS_SIZE 640
+#define LOCAL_API_EVENT_SIZE 192
+
+// Largest accepted client message in bytes.
+#define LOCAL_API_REQUEST_SIZE 160
+
+// JSON arena for requests and replies. ArduinoJson allocates variants in pools of about 1 KB, and a
+// request document stays alive while its reply is built, so the arena has to hold two pools.
+#define LOCAL_API_REQUEST_ARENA_SIZE 3072
+
+// Time a client has to authenticate after connecting, in milliseconds.
+#define LOCAL_API_AUTH_TIMEOUT 3000
+
+// Time a client may keep its queue full before it is closed, in milliseconds.
+#define LOCAL_API_STALL_TIMEOUT 10000
+
+// Struct to hold the endpoint counters.
+struct LocalApiStats {
+  uint8_t clients;         // Authenticated clients.
+  uint32_t commands;       // Watering commands received from local clients.
+  uint32_t authFailures;   // Rejected tokens and unauthenticated requests.
+  uint32_t sent;           // Messages handed to the WebSocket library.
+  uint32_t coalesced;      // Snapshots replaced by a newer one before they were sent.
+  uint32_t dropped;        // Events and replies skipped because a client was behind.
+  uint32_t stalled;        // Clients closed because their queue stayed full.
+  uint32_t jsonFallbacks;  // Request and reply allocations served by the heap.
+};
+
+class LocalApi {
+public:
+  /**
+  * Constructs a LocalApi object.
+  *
+  * @param port TCP port of the endpoint.
+  */
+  LocalApi(uint16_t port);
+
+  /**
+  * Starts the web server. Call once the network interface is up.
+  *
+  * @param token Token clients authenticate with, must outlive the endpoint.
+  * @param commands Queue that watering commands are pushed to.
+  * @return true if the endpoint was started; false if the token is empty or the lock could not be created.
+  */
+  bool begin(const char* token, CommandQueue& commands);
+
+  /**
+  * Checks if the endpoint was started.
+  *
+  * @return true if begin() succeeded; false otherwise.
+  */
+  bool isRunning() const;
+
+  /**
+  * Replaces the status snapshot. Must be called from the task that calls update().
+  *
+  * @param doc The status document.
+  */
+  void publishStatus(const JsonDocument& doc);
+
+  /**
+  * Replaces the metrics snapshot. Must be called from the task that calls update().
+  *
+  * @param doc The metrics document.
+  */
+  void publishMetrics(const JsonDocument& doc);
+
+  /**
+  * Adds an event to the ring. Must be called from the task that calls update().
+  *
+  * @param doc The event document.
+  */
+  void publishEvent(const JsonDocument& doc);
+
+  /**
+  * Sends pending snapshots and events to every client with room in its queue and closes clients
+  * that did not authenticate in time or stayed blocked. Never waits for a client.
+  *
+  * @param now Current time in milliseconds.
+  */
+  void update(uint32_t now);
+
+  /**
+  * Returns the endpoint counters.
+  * Safe to call from any task.
+  *
+  * @return Copy of the endpoint counters.
+  */
+  LocalApiStats stats() const;
+
+private:
+  // Struct to hold the state of a connected client.
+  struct Client {
+    uint32_t id;            // WebSocket client identifier, 0 for a free slot.
+    AsyncWebSocketClient* client;  // Valid until disconnect() clears the slot.
+    bool authenticated;     // Token was accepted.
+    uint32_t connectedAt;   // Connection time in milliseconds.
+    uint32_t blockedSince;  // Time the client queue filled up, 0 if it has room.
+    uint32_t statusSent;    // Version of the last status snapshot sent.
+    uint32_t metricsSent;   // Version of the last metrics snapshot sent.
+    uint32_t nextEvent;     // Sequence number of the next event to send.
+    bool fresh;             // Event sequence not set yet.
+    bool resend;            // Client asked for the current snapshots.
+  };
+
+  void handleEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+  void connect(AsyncWebSocketClient* client);
+  void disconnect(AsyncWebSocketClient* client);
+  void receive(AsyncWebSocketClient* client, const uint8_t* data, size_t len);
+  void reply(AsyncWebSocketClient* client, const char* type, const char* id, const char* status);
+  bool send(AsyncWebSocketClient* client, const char* message, size_t length);
+  bool pump(Client& state);
+  Client* find(uint32_t id);
+  bool checkToken(const char* token) const;
+
+  AsyncWebServer _server;
+  AsyncWebSocket _ws;
+  const char* _token;
+  CommandQueue* _commands;
+  SemaphoreHandle_t _lock;  // Guards _clients, _stats and every send between the WebSocket and update() tasks.
+  Client _clients[LOCAL_API_MAX_CLIENTS];
+  LocalApiStats _stats;
+
+  // Snapshots and events, written and read only by the update() task.
+  char _status[LOCAL_API_STATUS_SIZE];
+  size_t _statusLength;
+  uint32_t _statusVersion;
+  char _metrics[LOCAL_API_METRICS_SIZE];
+  size_t _metricsLength;
+  uint32_t _metricsVersion;
+  char _events[LOCAL_API_EVENT_DEPTH][LOCAL_API_EVENT_SIZE];
+  size_t _eventLengths[LOCAL_API_EVENT_DEPTH];
+  uint32_t _eventCount;
+
+  // Requests are parsed in the WebSocket task, which never holds more than one.
+  uint8_t _requestBuffer[LOCAL_API_REQUEST_ARENA_SIZE] __attribute__((aligned(8)));
+  JsonArena _requestArena;
+};
+
+#endif
@@ -0,0 +1,74 @@
+/**
+* NeoPixelOutput.h
+* NeoPixel backend of the AudioVisualNotifications template.
+*
+* This file contains the NeoPixelOutput class, which drives a strip of WS2812 pixels through the
+* Adafruit NeoPixel library. Pin, pixel count and brightness are template parameters taken from the
+* board profile.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef NEO_PIXEL_OUTPUT_H
+#define NEO_PIXEL_OUTPUT_H
+
+#include "Arduino.h"
+#include "Adafruit_NeoPixel.h"
+
+/**
+* NeoPixel strip in GRB order at 800 kHz.
+*
+* @tparam Pin The GPIO pin connected to the NeoPixel data line.
+* @tparam Count The number of NeoPixels in the strip.
+* @tparam Brightness The brightness level of the NeoPixels (0-255).
+*/
+template <int8_t Pin, uint8_t Count, uint8_t Brightness>
+class NeoPixelOutput {
+public:
+  static constexpr uint8_t count = Count;
+
+  NeoPixelOutput()
+    : _neoPixel(Count, Pin, NEO_GRB + NEO_KHZ800) {}
+
+  void begin() {
+    _neoPixel.begin();
+    _neoPixel.clear();
+    _neoPixel.show();
+    _neoPixel.setBrightness(Brightness);
+  }
+
+  void set(uint8_t pixel, uint8_t red, uint8_t green, uint8_t blue) {
+    _neoPixel.setPixelColor(pixel, red, green, blue);
+  }
+
+  void clear() {
+    _neoPixel.clear();
+  }
+
+  void show() {
+    _neoPixel.show();
+  }
+
+private:
+  Adafruit_NeoPixel _neoPixel;
+};
+
+#endif
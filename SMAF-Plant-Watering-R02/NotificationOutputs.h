@@ -0,0 +1,200 @@
+/**
+* NotificationOutputs.h
+* Light and speaker backends of the AudioVisualNotifications template.
+*
+* This file contains the backends that only need the Arduino core: a status LED on a plain GPIO,
+* a speaker driven with tone(), empty backends for boards without LEDs or speaker, and mock
+* backends that record their output for host builds. The NeoPixel backend lives in NeoPixelOutput.h,
+* so boards without NeoPixels do not pull in the library.
+*
+* A light backend provides a compile-time pixel count and begin(), set(), clear() and show(). A
+* speaker backend provides a compile-time enabled flag and play() and stop().
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef NOTIFICATION_OUTPUTS_H
+#define NOTIFICATION_OUTPUTS_H
+
+#include "Arduino.h"
+
+/**
+* Single status LED on a GPIO. Any color other than black turns it on.
+*
+* @tparam Pin The GPIO pin connected to the LED.
+* @tparam ActiveLow True if the LED lights up when the pin is low.
+*/
+template <int8_t Pin, bool ActiveLow = false>
+class GpioLedOutput {
+public:
+  static constexpr uint8_t count = 1;
+
+  GpioLedOutput()
+    : _on(false) {}
+
+  void begin() {
+    pinMode(Pin, OUTPUT);
+    show();
+  }
+
+  void set(uint8_t pixel, uint8_t red, uint8_t green, uint8_t blue) {
+    _on = (red | green | blue) != 0;
+  }
+
+  void clear() {
+    _on = false;
+  }
+
+  void show() {
+    digitalWrite(Pin, _on != ActiveLow ? HIGH : LOW);
+  }
+
+private:
+  bool _on;
+};
+
+// Boards without status LEDs, every call compiles away.
+class NoLightOutput {
+public:
+  static constexpr uint8_t count = 0;
+
+  void begin() {}
+  void set(uint8_t pixel, uint8_t red, uint8_t green, uint8_t blue) {}
+  void clear() {}
+  void show() {}
+};
+
+/**
+* Records the pixel colors instead of driving LEDs, for host builds.
+*
+* @tparam Count The number of pixels.
+*/
+template <uint8_t Count>
+class MockLightOutput {
+public:
+  static constexpr uint8_t count = Count;
+
+  MockLightOutput()
+    : _pixels{}, _frame{}, _shows(0) {}
+
+  void begin() {
+    clear();
+    show();
+  }
+
+  void set(uint8_t pixel, uint8_t red, uint8_t green, uint8_t blue) {
+    _pixels[pixel] = ((uint32_t)red << 16) | ((uint32_t)green << 8) | blue;
+  }
+
+  void clear() {
+    memset(_pixels, 0, sizeof(_pixels));
+  }
+
+  void show() {
+    memcpy(_frame, _pixels, sizeof(_frame));
+    _shows++;
+  }
+
+  /**
+  * Returns the color of a pixel as last shown, as 0xRRGGBB.
+  */
+  uint32_t shown(uint8_t pixel) const {
+    return _frame[pixel];
+  }
+
+  /**
+  * Returns the number of frames shown.
+  */
+  uint32_t shows() const {
+    return _shows;
+  }
+
+private:
+  uint32_t _pixels[Count];
+  uint32_t _frame[Count];
+  uint32_t _shows;
+};
+
+/**
+* Speaker driven with tone().
+*
+* @tparam Pin The GPIO pin connected to the speaker.
+*/
+template <int8_t Pin>
+class ToneSpeaker {
+public:
+  static constexpr bool enabled = true;
+
+  void play(uint16_t frequency) {
+    tone(Pin, frequency);
+  }
+
+  void stop() {
+    noTone(Pin);
+  }
+};
+
+// Boards without a speaker, melodies compile away.
+class NoSpeaker {
+public:
+  static constexpr bool enabled = false;
+
+  void play(uint16_t frequency) {}
+  void stop() {}
+};
+
+// Records the notes instead of playing them, for host builds.
+class MockSpeaker {
+public:
+  static constexpr bool enabled = true;
+
+  MockSpeaker()
+    : _frequency(0), _notes(0) {}
+
+  void play(uint16_t frequency) {
+    _frequency = frequency;
+    _notes++;
+  }
+
+  void stop() {
+    _frequency = 0;
+  }
+
+  /**
+  * Returns the frequency being played, zero when silent.
+  */
+  uint16_t frequency() const {
+    return _frequency;
+  }
+
+  /**
+  * Returns the number of notes played.
+  */
+  uint32_t notes() const {
+    return _notes;
+  }
+
+private:
+  uint16_t _frequency;
+  uint32_t _notes;
+};
+
+#endif
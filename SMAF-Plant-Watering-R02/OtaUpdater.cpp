@@ -0,0 +1,336 @@
+/**
+* OtaUpdater.cpp
+* Implementation of the streaming over-the-air updater.
+*
+* This file contains the implementation for the OtaUpdater class.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+#include "OtaUpdater.h"
+#include "Helpers.h"
+#include "HTTPClient.h"
+#include "Update.h"
+#include "LittleFS.h"
+#include "mbedtls/version.h"
+
+/**
+* Constructs an OtaUpdater object.
+*
+* @param history Watering history, suspended while the file system partition is rewritten.
+*/
+OtaUpdater::OtaUpdater(WateringHistory& history)
+  : _history(history),
+    _request{},
+    _result{ OTA_IDLE, NULL, 0, 0, 0 },
+    _state(OTA_IDLE),
+    _reported(true) {
+}
+
+/**
+* Parses the SHA-256 of an image.
+*
+* @param hex 64 hex characters.
+* @param digest Output digest.
+* @return true if the digest could be parsed; false otherwise.
+*/
+bool OtaUpdater::parseDigest(const char* hex, uint8_t digest[32]) {
+  if (hex == NULL || strlen(hex) != 64) {
+    return false;
+  }
+
+  for (size_t i = 0; i < 64; i++) {
+    char c = hex[i];
+    uint8_t nibble;
+
+    if (c >= '0' && c <= '9') {
+      nibble = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      nibble = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      nibble = c - 'A' + 10;
+    } else {
+      return false;
+    }
+
+    digest[i / 2] = (i % 2 == 0) ? nibble << 4 : digest[i / 2] | nibble;
+  }
+
+  return true;
+}
+
+/**
+* Starts an update in its own task.
+* Safe to call from the MQTT callback, the download runs in the background.
+*
+* @param request The update request.
+* @param core Core where the update task should run.
+* @param priority Priority of the update task.
+* @return true if the update was started; false if another update is running.
+*/
+bool OtaUpdater::start(const OtaRequest& request, BaseType_t core, UBaseType_t priority) {
+  // Only one update at a time, and the previous result must have been reported.
+  if (_state == OTA_RUNNING || !_reported) {
+    return false;
+  }
+
+  _request = request;
+  _result = { OTA_RUNNING, NULL, 0, 0, 0 };
+  _state = OTA_RUNNING;
+  _reported = false;
+
+  if (xTaskCreatePinnedToCore(task, "OtaThread", 8000, this, priority, NULL, core) != pdPASS) {
+    _result.state = OTA_FAILED;
+    _result.error = "no memory for update task";
+    _state = OTA_FAILED;
+  }
+
+  return true;
+}
+
+/**
+* Returns the current state of the updater.
+*
+* @return The updater state.
+*/
+OtaStateEnum OtaUpdater::state() const {
+  return _state;
+}
+
+/**
+* Takes the result of a finished update.
+* Returns true once per finished update, so the result is reported exactly once.
+*
+* @param request Filled with the finished request.
+* @param result Filled with the outcome.
+* @return true if a finished update was taken; false otherwise.
+*/
+bool OtaUpdater::takeResult(OtaRequest& request, OtaResult& result) {
+  if (_reported || _state == OTA_RUNNING) {
+    return false;
+  }
+
+  request = _request;
+  result = _result;
+  _reported = true;
+  return true;
+}
+
+void OtaUpdater::task(void* pvParameters) {
+  OtaUpdater* updater = (OtaUpdater*)pvParameters;
+  uint32_t start = millis();
+
+  bool succeeded = updater->run();
+
+  updater->_result.durationMs = millis() - start;
+  updater->_result.state = succeeded ? OTA_SUCCEEDED : OTA_FAILED;
+  updater->_state = updater->_result.state;
+
+  vTaskDelete(NULL);
+}
+
+bool OtaUpdater::run() {
+  debug(CMD, "OTA update from '%s' (%s, %s).", _request.url, _request.target == OTA_APP ? "app" : "filesystem", _request.compressed ? "zlib" : "raw");
+
+  // The chunk and the inflate state are the only large allocations, and only live during the update.
+  uint8_t* chunk = (uint8_t*)malloc(OTA_CHUNK_SIZE);
+  uint8_t* dictionary = _request.compressed ? (uint8_t*)malloc(TINFL_LZ_DICT_SIZE) : NULL;
+  tinfl_decompressor* inflater = _request.compressed ? (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor)) : NULL;
+
+  bool succeeded = false;
+
+  if (chunk == NULL || (_request.compressed && (dictionary == NULL || inflater == NULL))) {
+    fail("out of memory");
+  } else {
+    // The file system must not be in use while its partition is rewritten.
+    if (_request.target == OTA_FILESYSTEM) {
+      _history.suspend();
+      LittleFS.end();
+    }
+
+    if (!Update.begin(UPDATE_SIZE_UNKNOWN, _request.target == OTA_APP ? U_FLASH : U_SPIFFS)) {
+      fail(Update.errorString());
+    } else {
+      mbedtls_sha256_init(&_sha);
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+      mbedtls_sha256_starts(&_sha, 0);
+#else
+      mbedtls_sha256_starts_ret(&_sha, 0);
+#endif
+
+      succeeded = download(chunk, dictionary, inflater);
+
+      uint8_t digest[32];
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+      mbedtls_sha256_finish(&_sha, digest);
+#else
+      mbedtls_sha256_finish_ret(&_sha, digest);
+#endif
+      mbedtls_sha256_free(&_sha);
+
+      // Activate the new partition only if the uncompressed image matches the expected hash.
+      if (succeeded && memcmp(digest, _request.sha256, sizeof(digest)) != 0) {
+        succeeded = fail("SHA-256 mismatch");
+      }
+
+      if (succeeded && !Update.end(true)) {
+        succeeded = fail(Update.errorString());
+      }
+
+      if (!succeeded) {
+        Update.abort();
+      }
+    }
+
+    // Remount after a failure without formatting, a partition that no longer mounts is left for
+    // the next update to rewrite. After a success the history stays suspended until the restart.
+    if (_request.target == OTA_FILESYSTEM && !succeeded) {
+      if (!LittleFS.begin(false)) {
+        debug(ERR, "File system could not be mounted after the failed update.");
+      }
+      _history.resume();
+    }
+  }
+
+  free(inflater);
+  free(dictionary);
+  free(chunk);
+
+  return succeeded;
+}
+
+bool OtaUpdater::download(uint8_t* chunk, uint8_t* dictionary, tinfl_decompressor* inflater) {
+  HTTPClient http;
+
+  if (!http.begin(_request.url)) {
+    return fail("invalid URL");
+  }
+
+  int code = http.GET();
+  if (code != HTTP_CODE_OK) {
+    http.end();
+    return fail(code < 0 ? "connection failed" : "HTTP error");
+  }
+
+  int32_t remaining = http.getSize();  // -1 when the server does not send a length.
+  WiFiClient* stream = http.getStreamPtr();
+
+  size_t dictionaryOffset = 0;
+  tinfl_status status = TINFL_STATUS_NEEDS_MORE_INPUT;
+  if (inflater != NULL) {
+    tinfl_init(inflater);
+  }
+
+  uint32_t lastData = millis();
+  uint32_t lastProgress = 0;
+  bool succeeded = true;
+
+  while (succeeded && remaining != 0 && (http.connected() || stream->available() > 0)) {
+    size_t available = stream->available();
+
+    if (available == 0) {
+      if (millis() - lastData >= OTA_STALL_TIMEOUT) {
+        succeeded = fail("download stalled");
+      }
+      vTaskDelay(1);
+      continue;
+    }
+
+    size_t length = stream->readBytes(chunk, min<size_t>(available, OTA_CHUNK_SIZE));
+    lastData = millis();
+    _result.downloaded += length;
+    if (remaining > 0) {
+      remaining -= min<int32_t>(length, remaining);
+    }
+
+    if (inflater == NULL) {
+      succeeded = write(chunk, length);
+    } else {
+      // Inflate the chunk into the circular dictionary and flash every block it produces.
+      size_t inputOffset = 0;
+
+      while (succeeded) {
+        size_t inputSize = length - inputOffset;
+        size_t outputSize = TINFL_LZ_DICT_SIZE - dictionaryOffset;
+
+        status = tinfl_decompress(inflater, chunk + inputOffset, &inputSize, dictionary, dictionary + dictionaryOffset, &outputSize, TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        inputOffset += inputSize;
+
+        if (outputSize > 0) {
+          succeeded = write(dictionary + dictionaryOffset, outputSize);
+          dictionaryOffset = (dictionaryOffset + outputSize) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if (status < TINFL_STATUS_DONE) {
+          succeeded = fail("corrupt compressed image");
+        }
+
+        // Stop when the chunk is consumed and no buffered output is left, or at the end of the stream.
+        if (status == TINFL_STATUS_DONE || (status == TINFL_STATUS_NEEDS_MORE_INPUT && inputOffset >= length)) {
+          break;
+        }
+      }
+
+      if (status == TINFL_STATUS_DONE) {
+        break;
+      }
+    }
+
+    if (_result.downloaded - lastProgress >= 65536) {
+      lastProgress = _result.downloaded;
+      debug(LOG, "OTA update: %u bytes downloaded, %u bytes written.", _result.downloaded, _result.written);
+    }
+  }
+
+  http.end();
+
+  if (succeeded && (inflater == NULL ? remaining > 0 : status != TINFL_STATUS_DONE)) {
+    succeeded = fail("image truncated");
+  }
+
+  return succeeded;
+}
+
+bool OtaUpdater::write(const uint8_t* data, size_t length) {
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+  mbedtls_sha256_update(&_sha, data, length);
+#else
+  mbedtls_sha256_update_ret(&_sha, data, length);
+#endif
+
+  if (Update.write((uint8_t*)data, length) != length) {
+    return fail(Update.errorString());
+  }
+
+  _result.written += length;
+  return true;
+}
+
+bool OtaUpdater::fail(const char* error) {
+  // Keep the first error, later ones are consequences of it.
+  if (_result.error == NULL) {
+    _result.error = error;
+  }
+
+  debug(ERR, "OTA update failed: %s", error);
+  return false;
+}
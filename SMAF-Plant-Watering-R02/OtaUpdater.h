@@ -0,0 +1,139 @@
+/**
+* OtaUpdater.h
+* Declaration of the streaming over-the-air updater.
+*
+* This file contains the declaration for the OtaUpdater class, which downloads a firmware or LittleFS
+* image over HTTP and writes it to the inactive app partition or to the file system partition. Images
+* may be zlib compressed; they are inflated on the fly with the miniz decompressor in ROM, so memory
+* use is bounded by one download chunk and the 32 KB inflate dictionary regardless of image size. The
+* SHA-256 of the uncompressed image is verified before the new partition is activated.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef OTA_UPDATER_H
+#define OTA_UPDATER_H
+
+#include "Arduino.h"
+#include "mbedtls/sha256.h"
+#include "rom/miniz.h"
+#include "WateringHistory.h"
+
+// Size of one download chunk in bytes.
+#define OTA_CHUNK_SIZE 4096
+
+// Abort the download when no data arrives for this long, in milliseconds.
+#define OTA_STALL_TIMEOUT 15000
+
+// Enum to represent the partition an image is written to.
+enum OtaTargetEnum : byte {
+  OTA_APP,        // Inactive app partition, activated on success.
+  OTA_FILESYSTEM  // LittleFS partition with the web assets and history.
+};
+
+// Enum to represent the state of the updater.
+enum OtaStateEnum : byte {
+  OTA_IDLE,       // No update requested.
+  OTA_RUNNING,    // Update in progress.
+  OTA_SUCCEEDED,  // Image written and verified, restart to use it.
+  OTA_FAILED      // Update aborted, the running image is unchanged.
+};
+
+// Struct to hold an update request.
+struct OtaRequest {
+  char id[40];         // Command identifier, echoed in the result.
+  char url[256];       // HTTP URL of the image.
+  uint8_t sha256[32];  // SHA-256 of the uncompressed image.
+  OtaTargetEnum target;
+  bool compressed;     // Image is zlib compressed.
+};
+
+// Struct to hold the outcome of an update.
+struct OtaResult {
+  OtaStateEnum state;
+  const char* error;    // Reason of a failure, NULL on success.
+  uint32_t downloaded;  // Bytes received over HTTP.
+  uint32_t written;     // Bytes written to flash after decompression.
+  uint32_t durationMs;  // Duration of download, decompression and flashing.
+};
+
+class OtaUpdater {
+public:
+  /**
+  * Constructs an OtaUpdater object.
+  *
+  * @param history Watering history, suspended while the file system partition is rewritten.
+  */
+  OtaUpdater(WateringHistory& history);
+
+  /**
+  * Parses the SHA-256 of an image.
+  *
+  * @param hex 64 hex characters.
+  * @param digest Output digest.
+  * @return true if the digest could be parsed; false otherwise.
+  */
+  static bool parseDigest(const char* hex, uint8_t digest[32]);
+
+  /**
+  * Starts an update in its own task.
+  * Safe to call from the MQTT callback, the download runs in the background.
+  *
+  * @param request The update request.
+  * @param core Core where the update task should run.
+  * @param priority Priority of the update task.
+  * @return true if the update was started; false if another update is running.
+  */
+  bool start(const OtaRequest& request, BaseType_t core, UBaseType_t priority);
+
+  /**
+  * Returns the current state of the updater.
+  *
+  * @return The updater state.
+  */
+  OtaStateEnum state() const;
+
+  /**
+  * Takes the result of a finished update.
+  * Returns true once per finished update, so the result is reported exactly once.
+  *
+  * @param request Filled with the finished request.
+  * @param result Filled with the outcome.
+  * @return true if a finished update was taken; false otherwise.
+  */
+  bool takeResult(OtaRequest& request, OtaResult& result);
+
+private:
+  static void task(void* pvParameters);
+  bool run();
+  bool download(uint8_t* chunk, uint8_t* dictionary, tinfl_decompressor* inflater);
+  bool write(const uint8_t* data, size_t length);
+  bool fail(const char* error);
+
+  WateringHistory& _history;
+  OtaRequest _request;
+  OtaResult _result;
+  volatile OtaStateEnum _state;
+  volatile bool _reported;
+  mbedtls_sha256_context _sha;
+};
+
+#endif
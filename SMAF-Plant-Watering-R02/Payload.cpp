@@ -0,0 +1,331 @@
+/**
+* Payload.cpp
+* Implementation of the MQTT payload schema and encodings.
+*
+* This file contains the implementation of the functions that build, serialize and deserialize the
+* MQTT payloads exchanged with the broker.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+#include "Payload.h"
+#include "Helpers.h"
+#include <Preferences.h>
+
+/**
+* Builds the device status payload.
+*
+* @param doc The document to fill.
+* @param timestamp Human-readable timestamp in UTC format.
+* @param isWateringInProgress Whether the valve is open.
+* @param moisture Filtered moisture in permille.
+*/
+void constructStatusPayload(JsonDocument& doc, const char* timestamp, bool isWateringInProgress, uint16_t moisture) {
+  doc.clear();
+  doc["online"] = true;
+  doc["timestamp"] = timestamp;
+  doc["watering"] = isWateringInProgress;
+  doc["moisture"] = moisture;
+}
+
+/**
+* Builds the last-will payload published by the broker when the device drops off.
+*
+* @param doc The document to fill.
+*/
+void constructWillPayload(JsonDocument& doc) {
+  doc.clear();
+  doc["online"] = false;
+}
+
+/**
+* Builds the payload describing a watering controller decision.
+*
+* @param doc The document to fill.
+* @param timestamp Human-readable timestamp in UTC format.
+* @param event The controller decision to describe.
+*/
+void constructEventPayload(JsonDocument& doc, const char* timestamp, const WateringEvent& event) {
+  doc.clear();
+  doc["timestamp"] = timestamp;
+  doc["action"] = event.action == VALVE_OPEN ? "open" : "close";
+  doc["reason"] = wateringReasonName(event.reason);
+  doc["moisture"] = event.moisture;
+  doc["duration"] = event.durationMs;
+  doc["volumeToday"] = event.volumeToday;
+}
+
+/**
+* Builds the acknowledgement payload of a broker command.
+*
+* @param doc The document to fill.
+* @param commandId Identifier of the command.
+* @param status Outcome of the command.
+*/
+void constructAckPayload(JsonDocument& doc, const char* commandId, const char* status) {
+  doc.clear();
+  doc["id"] = commandId;
+  doc["status"] = status;
+}
+
+/**
+* Builds the acknowledgement payload reporting the outcome of an OTA update.
+* Throughput is the download rate in bytes per second, including decompression and flashing.
+*
+* @param doc The document to fill.
+* @param request The finished update request.
+* @param result The outcome of the update.
+*/
+void constructOtaResultPayload(JsonDocument& doc, const OtaRequest& request, const OtaResult& result) {
+  constructAckPayload(doc, request.id, result.state == OTA_SUCCEEDED ? "updated" : "failed");
+
+  if (result.error != NULL) {
+    doc["error"] = result.error;
+  }
+
+  doc["downloaded"] = result.downloaded;
+  doc["written"] = result.written;
+  doc["duration"] = result.durationMs;
+  doc["throughput"] = result.durationMs > 0 ? (uint32_t)((uint64_t)result.downloaded * 1000 / result.durationMs) : 0;
+}
+
+/**
+* Builds the payload containing a page of watering history.
+* Records are encoded as compact arrays of [start, duration, zone, trigger]. The "next" cursor is
+* included only when more records are available.
+*
+* @param doc The document to fill.
+* @param requestId Identifier echoed from the request.
+* @param since Start time the query was made for.
+* @param records Pointer to the records of this page.
+* @param count Number of records in this page.
+* @param cursor Cursor for the next page, or HISTORY_END.
+*/
+void constructHistoryPayload(JsonDocument& doc, const char* requestId, uint32_t since, const WateringRecord* records, size_t count, uint32_t cursor) {
+  doc.clear();
+  doc["id"] = requestId;
+  doc["since"] = since;
+
+  JsonArray list = doc["records"].to<JsonArray>();
+  for (size_t i = 0; i < count; i++) {
+    JsonArray record = list.add<JsonArray>();
+    record.add(records[i].start);
+    record.add(records[i].duration);
+    record.add(records[i].zone);
+    record.add(records[i].trigger);
+  }
+
+  if (cursor != HISTORY_END) {
+    doc["next"] = cursor;
+  }
+}
+
+/**
+* Builds the stored configuration payload sent to the setup portal.
+*
+* @param doc The document to fill.
+* @param prefs Preferences to read the configuration from.
+*/
+void constructConfigPayload(JsonDocument& doc, Preferences& prefs) {
+  doc.clear();
+  doc["action"] = "config_data";
+
+  prefs.begin("wifi_config", true);
+  doc["ssidName"] = prefs.getString("ssidName", "");
+  doc["ssidPassword"] = prefs.getString("ssidPassword", "");
+  doc["mqttServer"] = prefs.getString("mqttServer", "");
+  doc["mqttServerPort"] = prefs.getInt("mqttServerPort", 1883);
+  doc["mqttTls"] = prefs.getBool("mqttTls", false);
+  doc["mqttCaCert"] = prefs.getString("mqttCaCert", "");
+  doc["mqttFingerprint"] = prefs.getString("mqttFingerprint", "");
+  doc["mqttUsername"] = prefs.getString("mqttUsername", "");
+  doc["mqttPassword"] = prefs.getString("mqttPassword", "");
+  doc["mqttClientId"] = prefs.getString("mqttClientId", "");
+  doc["mqttTopic"] = prefs.getString("mqttTopic", "");
+  doc["mqttKeepAlive"] = prefs.getInt("mqttKeepAlive", 30);
+  doc["heartbeatInterval"] = prefs.getInt("heartbeat", 300);
+  doc["payloadEncoding"] = prefs.getInt("encoding", 0);
+  doc["localToken"] = prefs.getString("localToken", "");
+  doc["rgb"] = prefs.getBool("rgb", true);
+  doc["buzzer"] = prefs.getBool("buzzer", true);
+  prefs.end();
+}
+
+/**
+* Applies a partial controller parameter update from a config payload.
+* Fields missing from the payload keep their current value.
+*
+* @param doc The decoded config payload.
+* @param params The parameters to update.
+*/
+void mergeConfigPayload(const JsonDocument& doc, WateringParams& params) {
+  params.enabled = doc["enabled"] | params.enabled;
+  params.dryThreshold = doc["dryThreshold"] | params.dryThreshold;
+  params.wetThreshold = doc["wetThreshold"] | params.wetThreshold;
+  params.maxRunSeconds = doc["maxRunSeconds"] | params.maxRunSeconds;
+  params.soakSeconds = doc["soakSeconds"] | params.soakSeconds;
+  params.flowRate = doc["flowRate"] | params.flowRate;
+  params.dailyCap = doc["dailyCap"] | params.dailyCap;
+  params.sensorDryRaw = doc["sensorDryRaw"] | params.sensorDryRaw;
+  params.sensorWetRaw = doc["sensorWetRaw"] | params.sensorWetRaw;
+  params.filterShift = doc["filterShift"] | params.filterShift;
+}
+
+/**
+* Serializes a payload with the selected encoding.
+* Only object payloads are written, so the first byte always identifies the encoding the same way
+* detectPayloadEncoding() reads it: '{' for JSON and a map marker for MessagePack.
+*
+* @param doc The document to serialize.
+* @param encoding The payload encoding.
+* @param buffer Output buffer.
+* @param size Capacity of the output buffer.
+* @return Number of bytes written, or zero if the payload is not an object or does not fit.
+*/
+size_t serializePayload(const JsonDocument& doc, PayloadEncodingEnum encoding, uint8_t* buffer, size_t size) {
+  // Subscribers tell the encodings apart by the first byte, which only holds for objects.
+  if (!doc.is<JsonObjectConst>()) {
+    return 0;
+  }
+
+  // JSON text is written with a terminating zero, MessagePack is not.
+  size_t required = encoding == PAYLOAD_MSGPACK ? measureMsgPack(doc) : measureJson(doc) + 1;
+
+  // Refuse truncated payloads, a partial frame is worse than none.
+  if (required > size) {
+    return 0;
+  }
+
+  if (encoding == PAYLOAD_MSGPACK) {
+    return serializeMsgPack(doc, buffer, size);
+  }
+
+  return serializeJson(doc, (char*)buffer, size);
+}
+
+/**
+* Detects the encoding of an inbound payload from its first byte.
+*
+* @param payload Pointer to the payload data.
+* @param length Length of the payload data.
+* @return The detected payload encoding.
+*/
+PayloadEncodingEnum detectPayloadEncoding(const byte* payload, unsigned int length) {
+  if (length > 0 && ((payload[0] & 0xF0) == 0x80 || payload[0] == 0xDE || payload[0] == 0xDF)) {
+    return PAYLOAD_MSGPACK;
+  }
+
+  return PAYLOAD_JSON;
+}
+
+/**
+* Deserializes an inbound payload in either encoding.
+*
+* @param doc The document to fill.
+* @param payload Pointer to the payload data.
+* @param length Length of the payload data.
+* @return The deserialization result.
+*/
+DeserializationError deserializePayload(JsonDocument& doc, const byte* payload, unsigned int length) {
+  if (detectPayloadEncoding(payload, length) == PAYLOAD_MSGPACK) {
+    return deserializeMsgPack(doc, payload, length);
+  }
+
+  return deserializeJson(doc, payload, length);
+}
+
+/**
+* Returns a short name for a payload encoding.
+*
+* @param encoding The payload encoding.
+* @return A constant string describing the encoding.
+*/
+const char* payloadEncodingName(PayloadEncodingEnum encoding) {
+  return encoding == PAYLOAD_MSGPACK ? "msgpack" : "json";
+}
+
+#ifdef PAYLOAD_BENCHMARK
+/**
+* Legacy status message construction by string concatenation, kept as the benchmark baseline.
+*
+* @param timestamp Human-readable timestamp in UTC format.
+* @param isWateringInProgress Whether the valve is open.
+* @param moisture Filtered moisture in permille.
+* @return The status message in JSON format.
+*/
+String constructLegacyStatusMessage(String timestamp, bool isWateringInProgress, uint16_t moisture) {
+  String message;
+
+  message += "{";
+  message += quotation("online") + ":true,";
+  message += quotation("timestamp") + ":" + quotation(timestamp) + ",";
+  message += quotation("watering") + ":" + (isWateringInProgress ? "true" : "false") + ",";
+  message += quotation("moisture") + ":" + String(moisture);
+  message += "}";
+
+  return message;
+}
+
+/**
+* Logs payload size and encode/decode time of the status and command paths.
+* The legacy string concatenation path is measured alongside the JSON and MessagePack encodings.
+*
+* @param iterations Number of iterations per measurement.
+*/
+void benchmarkPayloads(uint32_t iterations) {
+  const char* timestamp = "2025-06-20T20:56:59Z";
+  uint8_t buffer[256];
+  size_t length = 0;
+  JsonDocument doc;
+
+  uint32_t start = micros();
+  for (uint32_t i = 0; i < iterations; i++) {
+    length = constructLegacyStatusMessage(timestamp, true, 512).length();
+  }
+  debug(LOG, "Payload benchmark: status legacy string, %u bytes, %u ns/op.", (unsigned int)length, (uint32_t)((uint64_t)(micros() - start) * 1000 / iterations));
+
+  for (byte encoding = PAYLOAD_JSON; encoding <= PAYLOAD_MSGPACK; encoding++) {
+    start = micros();
+    for (uint32_t i = 0; i < iterations; i++) {
+      constructStatusPayload(doc, timestamp, true, 512);
+      length = serializePayload(doc, (PayloadEncodingEnum)encoding, buffer, sizeof(buffer));
+    }
+    debug(LOG, "Payload benchmark: status %s, %u bytes, %u ns/op.", payloadEncodingName((PayloadEncodingEnum)encoding), (unsigned int)length, (uint32_t)((uint64_t)(micros() - start) * 1000 / iterations));
+  }
+
+  // Decode a typical command in both encodings.
+  doc.clear();
+  doc["id"] = "4f1c2a";
+  doc["watering"] = true;
+
+  for (byte encoding = PAYLOAD_JSON; encoding <= PAYLOAD_MSGPACK; encoding++) {
+    length = serializePayload(doc, (PayloadEncodingEnum)encoding, buffer, sizeof(buffer));
+
+    JsonDocument command;
+    start = micros();
+    for (uint32_t i = 0; i < iterations; i++) {
+      deserializePayload(command, buffer, length);
+    }
+    debug(LOG, "Payload benchmark: command %s, %u bytes, %u ns/op.", payloadEncodingName((PayloadEncodingEnum)encoding), (unsigned int)length, (uint32_t)((uint64_t)(micros() - start) * 1000 / iterations));
+  }
+}
+#endif
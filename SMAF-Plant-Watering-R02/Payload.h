@@ -0,0 +1,187 @@
+/**
+* Payload.h
+* Declaration of the MQTT payload schema and encodings.
+*
+* This file contains the declaration of the functions that build the MQTT payloads exchanged with
+* the broker. Every payload is described once as a JsonDocument and can then be serialized either
+* as JSON text (the default) or as MessagePack. Inbound payloads are decoded by looking at the first
+* byte: JSON objects start with '{', MessagePack maps start with a map type byte (0x80-0x8F, 0xDE, 0xDF).
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include "Arduino.h"
+#include "ArduinoJson.h"
+#include "WateringController.h"
+#include "WateringHistory.h"
+#include "OtaUpdater.h"
+
+class Preferences;
+
+// Uncomment to log payload size and encode/decode time for each encoding at boot.
+// #define PAYLOAD_BENCHMARK
+
+// Enum to represent the payload encodings.
+enum PayloadEncodingEnum : byte {
+  PAYLOAD_JSON,    // JSON text, the default.
+  PAYLOAD_MSGPACK  // MessagePack binary.
+};
+
+/**
+* Builds the device status payload.
+*
+* @param doc The document to fill.
+* @param timestamp Human-readable timestamp in UTC format.
+* @param isWateringInProgress Whether the valve is open.
+* @param moisture Filtered moisture in permille.
+*/
+void constructStatusPayload(JsonDocument& doc, const char* timestamp, bool isWateringInProgress, uint16_t moisture);
+
+/**
+* Builds the last-will payload published by the broker when the device drops off.
+*
+* @param doc The document to fill.
+*/
+void constructWillPayload(JsonDocument& doc);
+
+/**
+* Builds the payload describing a watering controller decision.
+*
+* @param doc The document to fill.
+* @param timestamp Human-readable timestamp in UTC format.
+* @param event The controller decision to describe.
+*/
+void constructEventPayload(JsonDocument& doc, const char* timestamp, const WateringEvent& event);
+
+/**
+* Builds the acknowledgement payload of a broker command.
+*
+* @param doc The document to fill.
+* @param commandId Identifier of the command.
+* @param status Outcome of the command.
+*/
+void constructAckPayload(JsonDocument& doc, const char* commandId, const char* status);
+
+/**
+* Builds the acknowledgement payload reporting the outcome of an OTA update.
+* Throughput is the download rate in bytes per second, including decompression and flashing.
+*
+* @param doc The document to fill.
+* @param request The finished update request.
+* @param result The outcome of the update.
+*/
+void constructOtaResultPayload(JsonDocument& doc, const OtaRequest& request, const OtaResult& result);
+
+/**
+* Builds the payload containing a page of watering history.
+* Records are encoded as compact arrays of [start, duration, zone, trigger]. The "next" cursor is
+* included only when more records are available.
+*
+* @param doc The document to fill.
+* @param requestId Identifier echoed from the request.
+* @param since Start time the query was made for.
+* @param records Pointer to the records of this page.
+* @param count Number of records in this page.
+* @param cursor Cursor for the next page, or HISTORY_END.
+*/
+void constructHistoryPayload(JsonDocument& doc, const char* requestId, uint32_t since, const WateringRecord* records, size_t count, uint32_t cursor);
+
+/**
+* Builds the stored configuration payload sent to the setup portal.
+*
+* @param doc The document to fill.
+* @param prefs Preferences to read the configuration from.
+*/
+void constructConfigPayload(JsonDocument& doc, Preferences& prefs);
+
+/**
+* Applies a partial controller parameter update from a config payload.
+* Fields missing from the payload keep their current value.
+*
+* @param doc The decoded config payload.
+* @param params The parameters to update.
+*/
+void mergeConfigPayload(const JsonDocument& doc, WateringParams& params);
+
+/**
+* Serializes a payload with the selected encoding.
+* Only object payloads are written, so the first byte always identifies the encoding the same way
+* detectPayloadEncoding() reads it: '{' for JSON and a map marker for MessagePack.
+*
+* @param doc The document to serialize.
+* @param encoding The payload encoding.
+* @param buffer Output buffer.
+* @param size Capacity of the output buffer.
+* @return Number of bytes written, or zero if the payload is not an object or does not fit.
+*/
+size_t serializePayload(const JsonDocument& doc, PayloadEncodingEnum encoding, uint8_t* buffer, size_t size);
+
+/**
+* Detects the encoding of an inbound payload from its first byte.
+*
+* @param payload Pointer to the payload data.
+* @param length Length of the payload data.
+* @return The detected payload encoding.
+*/
+PayloadEncodingEnum detectPayloadEncoding(const byte* payload, unsigned int length);
+
+/**
+* Deserializes an inbound payload in either encoding.
+*
+* @param doc The document to fill.
+* @param payload Pointer to the payload data.
+* @param length Length of the payload data.
+* @return The deserialization result.
+*/
+DeserializationError deserializePayload(JsonDocument& doc, const byte* payload, unsigned int length);
+
+/**
+* Returns a short name for a payload encoding.
+*
+* @param encoding The payload encoding.
+* @return A constant string describing the encoding.
+*/
+const char* payloadEncodingName(PayloadEncodingEnum encoding);
+
+#ifdef PAYLOAD_BENCHMARK
+/**
+* Legacy status message construction by string concatenation, kept as the benchmark baseline.
+*
+* @param timestamp Human-readable timestamp in UTC format.
+* @param isWateringInProgress Whether the valve is open.
+* @param moisture Filtered moisture in permille.
+* @return The status message in JSON format.
+*/
+String constructLegacyStatusMessage(String timestamp, bool isWateringInProgress, uint16_t moisture);
+
+/**
+* Logs payload size and encode/decode time of the status and command paths.
+* The legacy string concatenation path is measured alongside the JSON and MessagePack encodings.
+*
+* @param iterations Number of iterations per measurement.
+*/
+void benchmarkPayloads(uint32_t iterations);
+#endif
+
+#endif
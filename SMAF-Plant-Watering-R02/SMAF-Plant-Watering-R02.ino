@@ -25,16 +25,26 @@
 
 #include "WiFi.h"
 #include "PubSubClient.h"
-#include "AudioVisualNotifications.h"
+#include "BoardProfile.h"
 #include "WiFiConfig.h"
 #include "Helpers.h"
+#include "WateringController.h"
+#include "WateringHistory.h"
+#include "Payload.h"
+#include "TlsSessionClient.h"
+#include "CommandTracker.h"
+#include "CommandQueue.h"
+#include "SolenoidDriver.h"
+#include "TaskLayout.h"
+#include "OtaUpdater.h"
+#include "FixedString.h"
+#include "JsonArena.h"
+#include "HeapMonitor.h"
+#include "LocalApi.h"
 #include "ArduinoJson.h"
+#include "LittleFS.h"
 #include "time.h"
 
-// Define constants for ESP32 core numbers.
-#define ESP32_CORE_PRIMARY 0    // Numeric value representing the primary core.
-#define ESP32_CORE_SECONDARY 1  // Numeric value representing the secondary core.
-
 // Enum to represent different device statuses.
 enum DeviceStatusEnum : byte {
   NONE,              // Disable RGB led.
@@ -45,24 +55,115 @@ enum DeviceStatusEnum : byte {
 };
 
 // Variable to store the current device status.
-DeviceStatusEnum deviceStatus = NONE;  // Initial state is set to NOT_READY.
+// Written by the network and control tasks and read by the others, so it is volatile.
+volatile DeviceStatusEnum deviceStatus = NONE;  // Initial state is set to NOT_READY.
 
 // Function prototype for the DeviceStatusThread function.
 void DeviceStatusThread(void* pvParameters);
 
+// Function prototype for the WateringControllerThread function.
+void WateringControllerThread(void* pvParameters);
+
+// Function prototype for the NetworkThread function.
+void NetworkThread(void* pvParameters);
+
+// Function prototype for the LocalApiThread function.
+void LocalApiThread(void* pvParameters);
+
 // Preferences variables.
-String networkName = String();
-String networkPass = String();
-String mqttServerAddress = String();
-String mqttUsername = String();
-String mqttPass = String();
-String mqttClientId = String();
-String mqttPingTopic = String();
-String mqttCommandTopic = String();
+// Strings are kept in fixed-capacity buffers sized from the portal field limits and are used in
+// place for the lifetime of the device, so they never touch the heap.
+typedef FixedString<CONFIG_TOPIC_LENGTH + CONFIG_TOPIC_SUFFIX_LENGTH> MqttTopic;
+
+WiFiConfig config;
+MqttTopic mqttStatusTopic;
+MqttTopic mqttCommandTopic;
+MqttTopic mqttConfigTopic;
+MqttTopic mqttEventTopic;
+MqttTopic mqttHistoryRequestTopic;
+MqttTopic mqttHistoryTopic;
+MqttTopic mqttAckTopic;
 uint16_t mqttServerPort = 0;
+bool mqttTls = false;
+uint16_t mqttKeepAlive = 0;
+uint32_t heartbeatInterval = 0;
 bool visualNotifications = false;
 bool audioNotifications = false;
-bool isWatering = false;
+volatile bool isWatering = false;  // Written by the control task, read by the network, UI and local tasks.
+
+// Set when the retained status must be republished, e.g. after a reconnect.
+bool statusPublishRequested = false;
+
+// Define the MQTT client message buffer size.
+#define MQTT_BUFFER_SIZE 1024
+
+// Selected payload encoding and the pre-encoded last-will message.
+// Neither encoding of the last-will contains a zero byte, so it can be passed as a C-string.
+PayloadEncodingEnum payloadEncoding = PAYLOAD_JSON;
+char mqttWillMessage[48] = {};
+
+/**
+* @brief Memory for the JSON documents of the network task.
+*
+* Every payload built or parsed by the network task, including those in the MQTT callback, lives in
+* this arena instead of the heap. The arena is reset whenever the last document is destroyed, so
+* it only has to hold the largest set of documents alive at the same time (a history page).
+*/
+#define JSON_ARENA_SIZE 8192
+static uint8_t jsonArenaBuffer[JSON_ARENA_SIZE] __attribute__((aligned(8)));
+JsonArena jsonArena(jsonArenaBuffer, sizeof(jsonArenaBuffer));
+
+// Heap snapshot of the steady state, reported in the status payload.
+HeapMonitor heapMonitor;
+
+/**
+* @brief Closed-loop watering controller and its decision queue.
+*
+* The controller is owned by WateringControllerThread, which samples the moisture sensor and drives
+* the solenoid without depending on the network. Decisions are queued and published by NetworkThread
+* whenever the broker is reachable.
+*/
+WateringController controller;
+QueueHandle_t wateringEventQueue = NULL;
+
+// Copy of the daily cap window that survives software resets (watchdog, OTA, ESP.restart).
+RTC_NOINIT_ATTR WateringUsage rtcWateringUsage;
+
+// Persistent log of watering runs, queried over <topic>/history/get.
+WateringHistory history;
+
+// Identifiers of recently applied commands, so redelivered QoS 1 messages are not applied twice.
+CommandTracker commandTracker;
+
+// Streaming firmware and file system updates, started by an "ota" command.
+OtaUpdater ota(history);
+
+/**
+* @brief Local WebSocket endpoint for LAN clients, started when a local token is configured.
+*
+* LocalApiThread owns the local snapshots and its own JSON arena. Controller decisions reach it
+* through localEventQueue, commands go from the WebSocket task straight into commandQueue, so
+* neither direction passes through the network task.
+*/
+#define LOCAL_STATUS_INTERVAL 1000   // Minimum time between moisture-only status updates in milliseconds.
+#define LOCAL_METRICS_INTERVAL 1000  // Time between metrics updates in milliseconds.
+#define LOCAL_JSON_ARENA_SIZE 2048
+
+LocalApi localApi(LOCAL_API_PORT);
+QueueHandle_t localEventQueue = NULL;
+static uint8_t localJsonArenaBuffer[LOCAL_JSON_ARENA_SIZE] __attribute__((aligned(8)));
+JsonArena localJsonArena(localJsonArenaBuffer, sizeof(localJsonArenaBuffer));
+
+/**
+* @brief Bounded queue between the MQTT callback and the controller task.
+*
+* serverResponse() only decodes and enqueues. WateringControllerThread drains the queue, keeps only
+* the latest valve command and holds the valve for VALVE_MIN_DWELL_MS between changes. Parameter
+* updates are merged into requestedParams in the callback, so every queued parameter set is complete
+* and only the latest one of a burst is applied and saved.
+*/
+CommandQueue commandQueue;
+WateringParams requestedParams;
 
 /**
 * @brief WiFiClient and PubSubClient instances for establishing MQTT communication.
@@ -74,21 +175,30 @@ WiFiClient wifiClient;          // Manages Wi-Fi connection.
 PubSubClient mqtt(wifiClient);  // Uses WiFiClient for MQTT communication.
 
 /**
-* @brief Constructs an instance of the AudioVisualNotifications class.
+* @brief TLS client used instead of wifiClient when TLS is enabled in the portal.
 *
-* Initializes an instance of the AudioVisualNotifications class with the provided configurations.
-* The NeoPixel pin should be set up as OUTPUT before calling this constructor.
+* The negotiated TLS session is cached across reconnects and software reboots, so only the
+* first connection after power-up pays for a full handshake.
+*/
+TlsSessionClient secureClient;
+
+/**
+* @brief Status LED and speaker of the board selected in BoardProfile.h.
 *
-* @param neoPixelPin The pin connected to the NeoPixel LED strip.
-* @param neoPixelCount The number of NeoPixels in the LED strip.
-* @param neoPixelBrightness The brightness level of the NeoPixels (0-255).
-* @param speakerPin The pin connected to the speaker for audio feedback.
+* Pins, pixel count and brightness are template parameters taken from the board profile, so
+* outputs the board does not have compile away.
 */
-AudioVisualNotifications notifications(4, 2, 30, 5);
+BoardNotifications notifications;
+
+// Define the pin for the configuration button and the moisture sensor.
+constexpr int configurationButton = boardProfile.configurationButtonPin;
+constexpr int moistureSensorPin = boardProfile.moistureSensorPin;
 
-// Define the pin for the configurationuration button.
-int configurationButton = 6;
-int solenoidPin = 8;
+// Define the solenoid valve output and its drive profile.
+// Use SOLENOID_PROFILE_DIRECT for valves that do not hold at reduced duty, and set the second
+// H-bridge pin in the board profile when using SOLENOID_PROFILE_LATCHING.
+SolenoidDriver solenoid(boardProfile.solenoidPin, boardProfile.solenoidPinB);
+const SolenoidProfile& solenoidProfile = SOLENOID_PROFILE_PEAK_HOLD;
 
 // NTP Server configuration.
 const char* ntpServer = "europe.pool.ntp.org";  // Global - pool.ntp.org
@@ -103,15 +213,15 @@ const int dstOffset = 0;
 *
 */
 void setup() {
-  // Create a new task (DeviceStatusThread) and assign it to the primary core (ESP32_CORE_PRIMARY).
+  // Create the UI task (DeviceStatusThread) on the core selected in TaskLayout.h.
   xTaskCreatePinnedToCore(
     DeviceStatusThread,    // Function to implement the task.
     "DeviceStatusThread",  // Name of the task.
-    8000,                  // Stack size in words.
+    UI_TASK_STACK,         // Stack size in words.
     NULL,                  // Task input parameter (e.g., delay).
-    1,                     // Priority of the task.
+    UI_TASK_PRIORITY,      // Priority of the task.
     NULL,                  // Task handle.
-    ESP32_CORE_SECONDARY   // Core where the task should run.
+    UI_TASK_CORE           // Core where the task should run.
   );
 
   // Initialize serial communication at a baud rate of 115200.
@@ -119,15 +229,17 @@ void setup() {
 
   // Set the pin mode for the configuration button to INPUT.
   pinMode(configurationButton, INPUT);
-  pinMode(solenoidPin, OUTPUT);
-  digitalWrite(solenoidPin, LOW);
+  if (!solenoid.begin(solenoidProfile)) {
+    debug(ERR, "Solenoid profile not supported on this wiring, using direct drive.");
+  }
+  pinMode(moistureSensorPin, INPUT);
 
   // Delay for 2400 milliseconds (2.4 seconds).
   delay(1600);
 
   // Print a formatted welcome message with build information.
-  String buildVersion = "v0.002";
-  String buildDate = "Q2, 2025.";
+  const char* buildVersion = "v0.002";
+  const char* buildDate = "Q2, 2025.";
   Serial.printf("\n\rSMAF-PLANT-WATERING-KIT, Crafted with love in Europe.\n\rBuild version: %s\n\rBuild date: %s\n\r\n\r", buildVersion, buildDate);
 
   // Initialize NTP server time configuration.
@@ -135,35 +247,64 @@ void setup() {
 
   // MQTT Client message buffer size.
   // Default is set to 256.
-  mqtt.setBufferSize(1024);
+  mqtt.setBufferSize(MQTT_BUFFER_SIZE);
 
   // Load and check configuration.
-  WiFiConfig config = loadWiFiConfig();
+  // Values longer than their field are left empty, which sends the device back to the portal.
+  bool isConfigurationLoaded = loadWiFiConfig(config);
+  if (isConfigurationLoaded) {
+    debug(SCS, "Loaded WiFi/MQTT Configuration");
+  } else {
+    debug(ERR, "Stored WiFi/MQTT Configuration exceeds the field limits.");
+  }
 
-  debug(SCS, "Loaded WiFi/MQTT Configuration");
   debug(LOG, "SSID Name: %s", config.ssidName.c_str());
   debug(LOG, "SSID Password: %s", config.ssidPassword.c_str());
   debug(LOG, "MQTT Server: %s", config.mqttServer.c_str());
-  debug(LOG, "MQTT Port: %s", String(config.mqttServerPort));
+  debug(LOG, "MQTT Port: %d", config.mqttServerPort);
+  debug(LOG, "MQTT TLS: %s", config.mqttTls ? "true" : "false");
   debug(LOG, "MQTT Username: %s", config.mqttUsername.c_str());
   debug(LOG, "MQTT Password: %s", config.mqttPassword.c_str());
   debug(LOG, "MQTT Client ID: %s", config.mqttClientId.c_str());
   debug(LOG, "MQTT Topic: %s", config.mqttTopic.c_str());
-  debug(LOG, "RGB Enabled: %s", String(config.rgb ? "true" : "false"));
-  debug(LOG, "Buzzer Enabled: %s", String(config.buzzer ? "true" : "false"));
-
-  static String mqttPingTopicStr = config.mqttTopic + "/status";
-  static String mqttCommandTopicStr = config.mqttTopic + "/cmd";
-
-  networkName = config.ssidName;
-  networkPass = config.ssidPassword;
-  mqttServerAddress = config.mqttServer;
-  mqttUsername = config.mqttUsername;
-  mqttPass = config.mqttPassword;
-  mqttClientId = config.mqttClientId;
+  debug(LOG, "MQTT Keep Alive: %ds", config.mqttKeepAlive);
+  debug(LOG, "Heartbeat Interval: %ds", config.heartbeatInterval);
+  debug(LOG, "Payload Encoding: %s", payloadEncodingName((PayloadEncodingEnum)config.payloadEncoding));
+  debug(LOG, "RGB Enabled: %s", config.rgb ? "true" : "false");
+  debug(LOG, "Buzzer Enabled: %s", config.buzzer ? "true" : "false");
+  debug(LOG, "Local Control: %s", config.localToken.isEmpty() ? "disabled" : "enabled");
+
+  // Topic buffers hold the longest base topic plus the longest suffix, so formatting cannot fail.
+  mqttStatusTopic.format("%s/status", config.mqttTopic.c_str());
+  mqttCommandTopic.format("%s/cmd", config.mqttTopic.c_str());
+  mqttConfigTopic.format("%s/config", config.mqttTopic.c_str());
+  mqttEventTopic.format("%s/event", config.mqttTopic.c_str());
+  mqttHistoryRequestTopic.format("%s/history/get", config.mqttTopic.c_str());
+  mqttHistoryTopic.format("%s/history", config.mqttTopic.c_str());
+  mqttAckTopic.format("%s/ack", config.mqttTopic.c_str());
+
   mqttServerPort = config.mqttServerPort;
-  mqttPingTopic = mqttPingTopicStr;
-  mqttCommandTopic = mqttCommandTopicStr;
+  mqttTls = config.mqttTls;
+  mqttKeepAlive = config.mqttKeepAlive;
+  heartbeatInterval = max(config.heartbeatInterval, 10);  // Guard against publishing on every loop.
+  payloadEncoding = config.payloadEncoding == PAYLOAD_MSGPACK ? PAYLOAD_MSGPACK : PAYLOAD_JSON;
+
+  JsonDocument willDoc;
+  constructWillPayload(willDoc);
+  serializePayload(willDoc, payloadEncoding, (uint8_t*)mqttWillMessage, sizeof(mqttWillMessage));
+
+#ifdef PAYLOAD_BENCHMARK
+  benchmarkPayloads(1000);
+#endif
+
+  // Switch the MQTT client to TLS, verified against the pinned CA or the server fingerprint.
+  if (mqttTls) {
+    secureClient.setCACert(config.mqttCaCert.c_str());
+    if (config.mqttCaCert.isEmpty() && !secureClient.setFingerprint(config.mqttFingerprint.c_str())) {
+      debug(ERR, "TLS server fingerprint is invalid.");
+    }
+    mqtt.setClient(secureClient);
+  }
   visualNotifications = config.rgb ? true : false;
   audioNotifications = config.buzzer ? true : false;
 
@@ -178,12 +319,12 @@ void setup() {
 
   delay(1200);
 
-  static bool isConfigurationValid = config.ssidName.length() > 0 && config.mqttServer.length() > 0 && config.mqttClientId.length() > 0 && config.mqttTopic.length() > 0 && config.mqttServerPort > 0;
+  static bool isConfigurationValid = isConfigurationLoaded && config.ssidName.length() > 0 && config.mqttServer.length() > 0 && config.mqttClientId.length() > 0 && config.mqttTopic.length() > 0 && config.mqttServerPort > 0;
 
   if (isConfigurationValid) {
     debug(SCS, "Configuration is valid. All required configuration data is present.");
   } else {
-    debug(ERR, "Configuration is incomplete. Some required fields are missing.");
+    debug(ERR, "Configuration is incomplete. Some required fields are missing or too long.");
   }
 
   if ((digitalRead(configurationButton) == LOW) || (!isConfigurationValid)) {
@@ -205,105 +346,478 @@ void setup() {
     }
   }
 
-  // Setup hardware Watchdog timer. Bark Bark.
-  initWatchdog(30, true);
+  // Mount the file system and load the watering history index.
+  if (LittleFS.begin(true) && history.begin()) {
+    debug(SCS, "Watering history loaded, %u records stored.", (unsigned int)history.count());
+  } else {
+    debug(ERR, "Watering history unavailable.");
+  }
+
+  // Load watering controller parameters and start the control loop.
+  // The controller runs independently of the network so watering continues through outages.
+  controller.loadParams();
+  debug(LOG, "Automatic watering: %s", controller.params().enabled ? "enabled" : "disabled");
+
+  // Keep the daily cap across restarts. RTC memory is current to the last tick, the stored copy
+  // to the last finished run, which is all that survives a power loss.
+  if (controller.restoreUsage(rtcWateringUsage) || controller.loadUsage()) {
+    debug(LOG, "Daily volume so far: %u ml.", (unsigned int)controller.volumeToday());
+  }
+
+  requestedParams = controller.params();
+
+  wateringEventQueue = xQueueCreate(16, sizeof(WateringEvent));
+
+  // The control task checks this queue, so it has to exist before that task starts.
+  if (!config.localToken.isEmpty()) {
+    localEventQueue = xQueueCreate(LOCAL_API_EVENT_DEPTH, sizeof(WateringEvent));
+  }
+
+  commandQueue.begin();
+
+  xTaskCreatePinnedToCore(
+    WateringControllerThread,    // Function to implement the task.
+    "WateringControllerThread",  // Name of the task.
+    CONTROL_TASK_STACK,          // Stack size in words.
+    NULL,                        // Task input parameter (e.g., delay).
+    CONTROL_TASK_PRIORITY,       // Priority of the task.
+    NULL,                        // Task handle.
+    CONTROL_TASK_CORE            // Core where the task should run.
+  );
+
+  // Hand Wi-Fi, MQTT and publishing over to the network task.
+  xTaskCreatePinnedToCore(
+    NetworkThread,          // Function to implement the task.
+    "NetworkThread",        // Name of the task.
+    NETWORK_TASK_STACK,     // Stack size in words.
+    NULL,                   // Task input parameter (e.g., delay).
+    NETWORK_TASK_PRIORITY,  // Priority of the task.
+    NULL,                   // Task handle.
+    NETWORK_TASK_CORE       // Core where the task should run.
+  );
+
+  // Serve local clients next to the network task when a local token is configured.
+  if (localEventQueue != NULL) {
+    xTaskCreatePinnedToCore(
+      LocalApiThread,           // Function to implement the task.
+      "LocalApiThread",         // Name of the task.
+      LOCAL_API_TASK_STACK,     // Stack size in words.
+      NULL,                     // Task input parameter (e.g., delay).
+      LOCAL_API_TASK_PRIORITY,  // Priority of the task.
+      NULL,                     // Task handle.
+      LOCAL_API_TASK_CORE       // Core where the task should run.
+    );
+  }
+
+  debug(LOG, "Board: %s (%u status pixels, speaker %s).", boardProfile.name, (unsigned int)BoardLightOutput::count, BoardSpeaker::enabled ? "enabled" : "disabled");
+  debug(LOG, "Task layout: %s (network core %u, control core %u, UI core %u).", TASK_LAYOUT_NAME, NETWORK_TASK_CORE, CONTROL_TASK_CORE, UI_TASK_CORE);
 }
 
 /**
 * @brief Main execution loop for the SMAF-Development-Kit.
 *
-* This function runs repeatedly in a loop after the initial setup.
-* It is the core of your Arduino program, where continuous tasks and operations should be placed.
-* Be mindful of keeping the loop efficient and avoiding long blocking operations.
+* All work runs in the network, control and UI tasks created by setup(), so the Arduino loop task
+* deletes itself and frees its stack.
 *
 */
 void loop() {
-  static unsigned long mqttPostTimer = 0;
+  vTaskDelete(NULL);
+}
 
-  if (millis() - mqttPostTimer >= 2000) {
-    mqttPostTimer = millis();
+/**
+* @brief Thread function for Wi-Fi, MQTT I/O and publishing.
+*
+* This thread keeps the Wi-Fi and MQTT connections up, runs the MQTT client, publishes the status
+* and forwards watering controller decisions. Incoming commands are decoded in serverResponse()
+* and queued for the control task, so a slow broker never delays the valve.
+*
+* @param pvParameters Pointer to task parameters (not used in this function).
+*/
+void NetworkThread(void* pvParameters) {
+  unsigned long heartbeatTimer = 0;
+  unsigned long watchdogTimer = 0;
+  bool publishedWatering = false;
+  DeviceStatusEnum publishedStatus = NONE;
 
+  // Setup hardware Watchdog timer for this task. Bark Bark.
+  initWatchdog(30, true);
+
+  while (true) {
     // Attempt to connect to the Wi-Fi network.
     connectToNetwork();
 
     // Attempt to connect to the MQTT broker.
     connectToMqttBroker();
 
-    // Store MQTT data here.
-    String mqttData = String();
-    String timestamp = getUtcTimeString();
-    mqttData = constructMqttMessage(timestamp, isWatering);
+    // Publish on watering or status transitions, otherwise only at the heartbeat interval.
+    bool changed = isWatering != publishedWatering || deviceStatus != publishedStatus || statusPublishRequested;
+
+    if (changed || millis() - heartbeatTimer >= heartbeatInterval * 1000UL) {
+      heartbeatTimer = millis();
+      publishedWatering = isWatering;
+      publishedStatus = deviceStatus;
+      statusPublishRequested = false;
+
+      // Store MQTT data here.
+      JsonDocument mqttData(&jsonArena);
+      char timestamp[UTC_TIME_LENGTH];
+      formatUtcTime(timestamp, sizeof(timestamp));
+      constructStatusPayload(mqttData, timestamp, publishedWatering, controller.moisture());
+      if (mqttTls) {
+        mqttData["tlsHandshake"] = secureClient.lastHandshakeTime();
+      }
+
+      addLatencyStats(mqttData);
+      addHeapStats(mqttData);
+      addCommandStats(mqttData);
+
+      // Publish the retained last-state message to the MQTT broker.
+      debug(CMD, "Posting data package to MQTT broker '%s' on topic '%s'.", config.mqttServer.c_str(), mqttStatusTopic.c_str());
+      if (publishPayload(mqttStatusTopic.c_str(), mqttData, true)) {
+        // Connected and publishing, from here on the heap should stay flat.
+        heapMonitor.markSteadyState();
+      }
+    }
 
-    // Publish a message to the MQTT broker.
-    debug(CMD, "Posting data package to MQTT broker '%s' on topic '%s'.", mqttServerAddress.c_str(), mqttPingTopic.c_str());
-    mqtt.publish(mqttPingTopic.c_str(), mqttData.c_str(), false);
+    // Report watering controller decisions upstream.
+    WateringEvent event;
+    while (mqtt.connected() && xQueueReceive(wateringEventQueue, &event, 0) == pdTRUE) {
+      JsonDocument eventData(&jsonArena);
+      char timestamp[UTC_TIME_LENGTH];
+      formatUtcTime(timestamp, sizeof(timestamp));
+      constructEventPayload(eventData, timestamp, event);
+      publishPayload(mqttEventTopic.c_str(), eventData, false);
+    }
+
+    // Report a finished OTA update and boot into the new image.
+    OtaRequest otaRequest;
+    OtaResult otaResult;
+    if (mqtt.connected() && ota.takeResult(otaRequest, otaResult)) {
+      debug(otaResult.state == OTA_SUCCEEDED ? SCS : ERR, "OTA update %s: %u bytes downloaded, %u bytes written in %u ms.", otaResult.state == OTA_SUCCEEDED ? "complete" : "failed", otaResult.downloaded, otaResult.written, otaResult.durationMs);
+
+      JsonDocument otaData(&jsonArena);
+      constructOtaResultPayload(otaData, otaRequest, otaResult);
+      publishPayload(mqttAckTopic.c_str(), otaData, false);
+
+      if (otaResult.state == OTA_SUCCEEDED) {
+        debug(CMD, "Restarting into the updated image.");
+        mqtt.disconnect();
+        delay(500);
+        ESP.restart();
+      }
+    }
+
+    // Process incoming data and MQTT keepalive.
+    // The watchdog catches a stuck network task, not an outage: it is fed here while connected and
+    // on every reconnect attempt, so the valve and local control keep running while offline.
+    if (mqtt.loop() && millis() - watchdogTimer >= 5000) {
+      watchdogTimer = millis();
+      resetWatchdog();
+    }
+
+    // Sleep between polls so lower priority tasks on this core get to run.
+    vTaskDelay(max<TickType_t>(1, pdMS_TO_TICKS(NETWORK_TASK_POLL_MS)));
+  }
+}
+
+/**
+* @brief Thread function for the local WebSocket endpoint.
+*
+* This thread starts the endpoint once Wi-Fi is up, turns controller decisions into events and
+* keeps the status and metrics snapshots current. Status changes are published right away,
+* moisture-only changes at most every LOCAL_STATUS_INTERVAL. Every pass hands pending messages to
+* the clients that have room, so a slow client only ever skips snapshots.
+*
+* @param pvParameters Pointer to task parameters (not used in this function).
+*/
+void LocalApiThread(void* pvParameters) {
+  unsigned long statusTimer = 0;
+  unsigned long metricsTimer = 0;
+  bool publishedWatering = false;
+  bool publishedOnline = false;
+
+  // The web server needs the network interface, which the network task brings up.
+  while (WiFi.status() != WL_CONNECTED) {
+    vTaskDelay(pdMS_TO_TICKS(500));
   }
 
-  // Check for incoming data on defined MQTT topic.
-  // This is hard core connection check.
-  // If no data on topic is received, we are not connected to internet or server and watchdog will reset the device.
-  mqtt.loop();
+  if (!localApi.begin(config.localToken.c_str(), commandQueue)) {
+    debug(ERR, "Local control endpoint could not be started.");
+    vTaskDelete(NULL);
+  }
+
+  debug(SCS, "Local control endpoint listening on ws://%s:%u/live", WiFi.localIP().toString().c_str(), LOCAL_API_PORT);
+
+  while (true) {
+    // Sleep until the controller reports a decision or the next update is due.
+    WateringEvent event;
+    if (xQueueReceive(localEventQueue, &event, pdMS_TO_TICKS(LOCAL_API_TASK_POLL_MS)) == pdTRUE) {
+      JsonDocument eventData(&localJsonArena);
+      char timestamp[UTC_TIME_LENGTH];
+      formatUtcTime(timestamp, sizeof(timestamp));
+      constructEventPayload(eventData, timestamp, event);
+      eventData["type"] = "event";
+      localApi.publishEvent(eventData);
+    }
+
+    bool online = deviceStatus != NOT_READY;
+    if (isWatering != publishedWatering || online != publishedOnline || millis() - statusTimer >= LOCAL_STATUS_INTERVAL) {
+      statusTimer = millis();
+      publishedWatering = isWatering;
+      publishedOnline = online;
+
+      // No timestamp, so an unchanged status is not sent again.
+      JsonDocument statusData(&localJsonArena);
+      statusData["type"] = "status";
+      statusData["online"] = publishedOnline;
+      statusData["watering"] = publishedWatering;
+      statusData["moisture"] = controller.moisture();
+      localApi.publishStatus(statusData);
+    }
+
+    if (millis() - metricsTimer >= LOCAL_METRICS_INTERVAL) {
+      metricsTimer = millis();
+
+      JsonDocument metricsData(&localJsonArena);
+      metricsData["type"] = "metrics";
+      addLatencyStats(metricsData);
+      addHeapStats(metricsData);
+      addCommandStats(metricsData);
+
+      LocalApiStats localStats = localApi.stats();
+      JsonObject local = metricsData["local"].to<JsonObject>();
+      local["clients"] = localStats.clients;
+      local["commands"] = localStats.commands;
+      local["authFailures"] = localStats.authFailures;
+      local["sent"] = localStats.sent;
+      local["coalesced"] = localStats.coalesced;
+      local["dropped"] = localStats.dropped;
+      local["stalled"] = localStats.stalled;
+      local["jsonFallbacks"] = localStats.jsonFallbacks;
+      localApi.publishMetrics(metricsData);
+    }
+
+    localApi.update(millis());
+  }
+}
+
+/**
+* @brief Adds the command queue counters to a status or metrics payload.
+*
+* Commands from the MQTT callback and from local clients share the same queue and counters.
+* Redelivered MQTT commands are caught before the queue and counted as duplicates.
+*
+* @param doc The document to extend.
+*/
+void addCommandStats(JsonDocument& doc) {
+  CommandQueueStats stats = commandQueue.stats();
+
+  JsonObject commands = doc["commands"].to<JsonObject>();
+  commands["received"] = stats.received;
+  commands["merged"] = stats.merged;
+  commands["dropped"] = stats.dropped;
+  commands["applied"] = stats.applied;
+  commands["duplicates"] = commandTracker.duplicates();
+}
+
+/**
+* @brief Adds the command-to-valve latency of the current task layout to the status payload.
+*
+* Latency is measured from the MQTT callback or a local client queueing a command to the control
+* task switching the solenoid. Jitter is the standard deviation. All values are in microseconds.
+*
+* @param doc The status document to extend.
+*/
+void addLatencyStats(JsonDocument& doc) {
+  CommandLatencyStats stats = commandQueue.latency();
+
+  JsonObject latency = doc["latency"].to<JsonObject>();
+  latency["layout"] = TASK_LAYOUT_NAME;
+  latency["samples"] = stats.samples;
+
+  if (stats.samples > 0) {
+    double mean = (double)stats.sumUs / stats.samples;
+    double variance = (double)stats.sumSquares / stats.samples - mean * mean;
+
+    latency["min"] = stats.minUs;
+    latency["mean"] = (uint32_t)mean;
+    latency["max"] = stats.maxUs;
+    latency["jitter"] = (uint32_t)sqrt(max(variance, 0.0));
+  }
+}
+
+/**
+* @brief Adds the heap sample and the JSON arena counters to the status payload.
+*
+* After the steady state snapshot, "drift" is the change in allocated heap blocks and "allocs" the
+* number of allocations (only with CONFIG_HEAP_USE_HOOKS). Both should stay flat over long runs.
+* "fragmentation" is the share of free heap not available as one block, in percent.
+*
+* @param doc The status document to extend.
+*/
+void addHeapStats(JsonDocument& doc) {
+  HeapStats stats = heapMonitor.sample();
+  JsonArenaStats arenaStats = jsonArena.stats();
+
+  JsonObject heap = doc["heap"].to<JsonObject>();
+  heap["free"] = stats.freeBytes;
+  heap["largest"] = stats.largestFreeBlock;
+  heap["minFree"] = stats.minimumFreeBytes;
+  heap["fragmentation"] = stats.fragmentation;
+  heap["blocks"] = stats.allocatedBlocks;
+  heap["drift"] = stats.blockDrift;
+
+  if (stats.countsAllocations) {
+    heap["allocs"] = stats.allocations;
+  }
+
+  heap["jsonPeak"] = arenaStats.peak;
+  heap["jsonFallbacks"] = arenaStats.fallbacks;
 }
 
 /**
 * @brief Handles the server response received on a specific MQTT topic.
 *
-* This function logs the server response using debug output. If the device status is not
-* in maintenance mode, it also resets the watchdog timer to prevent system reset.
+* This function logs the server response using debug output and dispatches commands,
+* controller parameters and history requests.
 *
 * @param topic The MQTT topic on which the server response was received.
 * @param payload Pointer to the payload data received from the server.
 * @param length Length of the payload data.
 */
 void serverResponse(char* topic, byte* payload, unsigned int length) {
-  debug(SCS, "Server '%s' responded. Message received on topic: '%s'", mqttServerAddress.c_str(), topic);
+  debug(SCS, "Server '%s' responded. Message received on topic: '%s'", config.mqttServer.c_str(), topic);
 
-  // Optional: compare topic strings if you need to react differently
-  if (strcmp(topic, mqttPingTopic.c_str()) == 0) {
-    // Convert payload to string
-    char messageBuffer[length + 1];
-    memcpy(messageBuffer, payload, length);
-    messageBuffer[length] = '\0';  // Null-terminate
+  // Log text payloads only, binary payloads are not printable.
+  if (detectPayloadEncoding(payload, length) == PAYLOAD_JSON) {
+    debug(SCS, "Payload: %.*s", length, (const char*)payload);
+  } else {
+    debug(SCS, "Payload: %u bytes %s", length, payloadEncodingName(PAYLOAD_MSGPACK));
+  }
 
-    debug(SCS, "Payload: %s", messageBuffer);
+  // Parse JSON or MessagePack, both share the same schema.
+  JsonDocument doc(&jsonArena);
+  DeserializationError error = deserializePayload(doc, payload, length);
 
-    // Reset WDT.
-    if (deviceStatus != MAINTENANCE_MODE) {
-      resetWatchdog();
-    }
-  } else if (strcmp(topic, mqttCommandTopic.c_str()) == 0) {
-    // Convert payload to string
-    char messageBuffer[length + 1];
-    memcpy(messageBuffer, payload, length);
-    messageBuffer[length] = '\0';  // Null-terminate
-
-    debug(SCS, "Payload: %s", messageBuffer);
-
-    // Parse JSON
-    // StaticJsonDocument<200> doc;  // Adjust size as needed
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, messageBuffer);
-
-    if (error) {
-      debug(ERR, "Failed to parse JSON: %s", error.c_str());
-      return;
-    }
+  if (error) {
+    debug(ERR, "Failed to parse payload: %s", error.c_str());
+    return;
+  }
+
+  bool isCommand = strcmp(topic, mqttCommandTopic.c_str()) == 0;
+  bool isConfig = strcmp(topic, mqttConfigTopic.c_str()) == 0;
+  const char* commandId = doc["id"] | "";
 
-    // Access values
-    isWatering = doc["watering"];
+  // Redelivered commands are acknowledged again but not applied twice. Identifiers are remembered
+  // only once a command has been accepted, so a command that was dropped or refused can be retried.
+  if ((isCommand || isConfig) && !isEmpty(commandId) && commandTracker.seen(commandId)) {
+    debug(LOG, "Duplicate command '%s' ignored.", commandId);
+    publishAck(commandId, "duplicate");
+    return;
+  }
 
-    if (isWatering) {
-      debug(SCS, "Watering plants in progress");
-      deviceStatus = WATERING_MODE;
-      digitalWrite(solenoidPin, HIGH);
+  // Optional: compare topic strings if you need to react differently
+  if (isCommand && doc["ota"].is<JsonObject>()) {
+    // Start the download in its own task, the result is acknowledged when it finishes.
+    JsonObject otaData = doc["ota"];
+    const char* url = otaData["url"] | "";
+
+    OtaRequest request = {};
+    strlcpy(request.id, commandId, sizeof(request.id));
+    strlcpy(request.url, url, sizeof(request.url));
+    request.target = strcmp(otaData["target"] | "app", "fs") == 0 ? OTA_FILESYSTEM : OTA_APP;
+    request.compressed = otaData["compressed"] | true;
+
+    bool valid = strncmp(url, "http://", 7) == 0 && strlen(url) < sizeof(request.url) && OtaUpdater::parseDigest(otaData["sha256"] | "", request.sha256);
+
+    if (!valid) {
+      debug(ERR, "OTA request rejected, a http:// URL and a SHA-256 are required.");
+      publishAck(commandId, "rejected");
     } else {
-      debug(SCS, "Watering plants complete");
-      deviceStatus = READY_TO_SEND;
-      digitalWrite(solenoidPin, LOW);
+      bool started = ota.start(request, NETWORK_TASK_CORE, 1);
+      if (started && !isEmpty(commandId)) {
+        commandTracker.remember(commandId);
+      }
+      publishAck(commandId, started ? "accepted" : "busy");
     }
+  } else if (isCommand) {
+    // Hand the manual request over to the controller task, which owns the valve.
+    bool queued = commandQueue.pushValve(doc["watering"]);
+    if (queued && !isEmpty(commandId)) {
+      commandTracker.remember(commandId);
+    }
+    publishAck(commandId, queued ? "accepted" : "dropped");
+  } else if (isConfig) {
+    // Apply partial updates on top of the last requested parameters.
+    WateringParams params = requestedParams;
+    mergeConfigPayload(doc, params);
+
+    // Storing the parameters writes to flash, which is left to the controller task.
+    bool queued = commandQueue.pushParams(params);
+    if (queued) {
+      if (!isEmpty(commandId)) {
+        commandTracker.remember(commandId);
+      }
+      requestedParams = params;
+      debug(SCS, "Watering controller parameters queued.");
+    }
+
+    publishAck(commandId, queued ? "accepted" : "dropped");
+  } else if (strcmp(topic, mqttHistoryRequestTopic.c_str()) == 0) {
+    // Serve one page of "runs since T", continuing from a cursor when given.
+    uint32_t since = doc["since"] | 0;
+    uint32_t cursor = doc["cursor"] | 0;
+    size_t limit = constrain(doc["limit"] | 32, 1, 32);
+
+    WateringRecord records[32];
+    size_t count = history.query(since, cursor, records, limit);
+
+    JsonDocument historyData(&jsonArena);
+    constructHistoryPayload(historyData, doc["id"] | "", since, records, count, cursor);
+    publishPayload(mqttHistoryTopic.c_str(), historyData, false);
+
+    debug(SCS, "Served %u watering history records.", (unsigned int)count);
   }
 }
 
+/**
+* @brief Publishes the acknowledgement of a command.
+*
+* Commands without an identifier are applied but not acknowledged.
+*
+* @param commandId Identifier of the command.
+* @param status Outcome of the command, e.g. "accepted" or "duplicate".
+*/
+void publishAck(const char* commandId, const char* status) {
+  if (isEmpty(commandId)) {
+    return;
+  }
+
+  JsonDocument ackData(&jsonArena);
+  constructAckPayload(ackData, commandId, status);
+  publishPayload(mqttAckTopic.c_str(), ackData, false);
+}
+
+/**
+* @brief Publishes a payload with the configured encoding.
+*
+* @param topic The MQTT topic to publish to.
+* @param doc The payload to serialize.
+* @param retained Whether the broker should retain the message.
+* @return true if the payload was published; false otherwise.
+*/
+bool publishPayload(const char* topic, const JsonDocument& doc, bool retained) {
+  static uint8_t buffer[MQTT_BUFFER_SIZE];
+  size_t length = serializePayload(doc, payloadEncoding, buffer, sizeof(buffer));
+
+  if (length == 0) {
+    debug(ERR, "Payload for topic '%s' is not an object or does not fit the MQTT buffer.", topic);
+    return false;
+  }
+
+  return mqtt.publish(topic, buffer, length, retained);
+}
+
 /**
 * @brief Attempt to connect SMAF-DK to the configurationured Wi-Fi network.
 *
@@ -311,7 +825,7 @@ void serverResponse(char* topic, byte* payload, unsigned int length) {
 * a connection using the settings from the WiFiconfiguration instance.
 *
 * @warning This function may delay for extended periods while attempting to connect
-* to the Wi-Fi network.
+* to the Wi-Fi network. The task watchdog is fed on every attempt.
 */
 void connectToNetwork() {
   if (WiFi.status() != WL_CONNECTED) {
@@ -323,19 +837,21 @@ void connectToNetwork() {
     WiFi.mode(WIFI_STA);
 
     // Log an error if not connected to the configurationured SSID.
-    debug(ERR, "Device not connected to '%s'.", networkName.c_str());
+    debug(ERR, "Device not connected to '%s'.", config.ssidName.c_str());
 
     // Keep attempting to connect until successful.
     while (WiFi.status() != WL_CONNECTED) {
-      debug(CMD, "Connecting device to '%s'", networkName.c_str());
+      // An outage is not a hang, every attempt returns well within the watchdog timeout.
+      resetWatchdog();
+      debug(CMD, "Connecting device to '%s'", config.ssidName.c_str());
 
       // Attempt to connect to the Wi-Fi network using configurationured credentials.
-      WiFi.begin(networkName, networkPass);
+      WiFi.begin(config.ssidName.c_str(), config.ssidPassword.c_str());
       delay(6400);
     }
 
     // Log successful connection and set device status.
-    debug(SCS, "Device connected to '%s'.", networkName.c_str());
+    debug(SCS, "Device connected to '%s'.", config.ssidName.c_str());
   }
 }
 
@@ -349,7 +865,7 @@ void connectToNetwork() {
 * username, password) have been previously set in the WiFiconfiguration instance.
 *
 * @warning This function may delay for extended periods while attempting to connect
-* to the MQTT broker.
+* to the MQTT broker. The task watchdog is fed on every attempt.
 */
 void connectToMqttBroker() {
   if (!mqtt.connected()) {
@@ -357,27 +873,39 @@ void connectToMqttBroker() {
     deviceStatus = NOT_READY;
 
     // Set MQTT server and connection parameters.
-    mqtt.setServer(mqttServerAddress.c_str(), mqttServerPort);
-    // mqtt.setKeepAlive(30000);     // To be configurationured on the settings page.
+    mqtt.setServer(config.mqttServer.c_str(), mqttServerPort);
+    mqtt.setKeepAlive(mqttKeepAlive);
     // mqtt.setSocketTimeout(4000);  // To be configurationured on the settings page.
     mqtt.setCallback(serverResponse);
 
     // Log an error if not connected.
-    debug(ERR, "Device not connected to MQTT broker '%s'.", mqttServerAddress.c_str());
+    debug(ERR, "Device not connected to MQTT broker '%s'.", config.mqttServer.c_str());
 
     // Keep attempting to connect until successful.
     while (!mqtt.connected()) {
-      debug(CMD, "Connecting device to MQTT broker '%s'.", mqttServerAddress.c_str());
+      // An outage is not a hang, every attempt returns well within the watchdog timeout.
+      resetWatchdog();
+      debug(CMD, "Connecting device to MQTT broker '%s'.", config.mqttServer.c_str());
 
-      if (mqtt.connect(mqttClientId.c_str(), mqttUsername.c_str(), mqttPass.c_str())) {
+      // The broker publishes the retained last-will on the status topic if the keepalive lapses.
+      // A persistent session (cleanSession = false) lets the broker queue QoS 1 commands while the device is offline.
+      if (mqtt.connect(config.mqttClientId.c_str(), config.mqttUsername.c_str(), config.mqttPassword.c_str(), mqttStatusTopic.c_str(), 1, true, mqttWillMessage, false)) {
         // Log successful connection and set device status.
-        debug(SCS, "Device connected to MQTT broker '%s'.", mqttServerAddress.c_str());
+        debug(SCS, "Device connected to MQTT broker '%s'.", config.mqttServer.c_str());
 
-        // Subscribe to MQTT topics.
-        mqtt.subscribe(mqttPingTopic.c_str());
-        mqtt.subscribe(mqttCommandTopic.c_str());
+        if (mqttTls) {
+          debug(LOG, "TLS handshake took %u ms (%s).", secureClient.lastHandshakeTime(), secureClient.lastHandshakeResumable() ? "resumed session offered" : "full handshake");
+        }
 
-        deviceStatus = READY_TO_SEND;
+        // Subscribe to MQTT topics.
+        // The client cannot see the session-present flag, so subscriptions are renewed; this does not drop queued messages.
+        mqtt.subscribe(mqttCommandTopic.c_str(), 1);
+        mqtt.subscribe(mqttConfigTopic.c_str(), 1);
+        mqtt.subscribe(mqttHistoryRequestTopic.c_str());
+
+        // Replace the last-will with the current state.
+        statusPublishRequested = true;
+        deviceStatus = isWatering ? WATERING_MODE : READY_TO_SEND;
       } else {
         // Retry after a delay if connection failed.
         delay(4000);
@@ -386,28 +914,6 @@ void connectToMqttBroker() {
   }
 }
 
-/**
-* @brief Retrieves the current UTC time as a formatted string.
-*
-* This function retrieves the current UTC time using the system time. If successful,
-* it formats the time into a UTC date time string (e.g., "2024-06-20T20:56:59Z").
-* If the UTC time cannot be obtained, it returns "Unknown".
-*
-* @return A String containing the current UTC time in the specified format, or "Unknown" if the time cannot be retrieved.
-*/
-String getUtcTimeString() {
-  struct tm timeinfo;
-
-  if (!getLocalTime(&timeinfo)) {
-    return "Unknown";
-  }
-
-  // Create a buffer to hold the formatted time string
-  char buffer[80];
-  strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
-  return String(buffer);
-}
-
 /**
 * @brief Constructs an MQTT message string containing GPS and time-related data.
 *
@@ -462,15 +968,67 @@ String constructMqttMessage(uint8_t satellitesInRange, int32_t longitude, int32_
 }
 */
 
-String constructMqttMessage(String timestamp, bool isWateringInProgress) {
-  String message;
+/**
+* @brief Thread function for the closed-loop watering controller.
+*
+* This thread samples the moisture sensor, runs the controller state machine and drives the
+* solenoid valve. It never touches the network, so the valve keeps reacting while Wi-Fi or the
+* broker are unavailable. Broker commands are taken from the command queue as soon as they arrive,
+* and decisions are queued for NetworkThread to publish.
+*
+* @param pvParameters Pointer to task parameters (not used in this function).
+*/
+void WateringControllerThread(void* pvParameters) {
+  WateringReasonEnum runTrigger = REASON_MANUAL;
+  unsigned long sampleTimer = 0;
 
-  message += "{";
-  message += quotation("timestamp") + ":" + quotation(timestamp) + ",";
-  message += quotation("watering") + ":" + (isWateringInProgress ? "true" : "false");
-  message += "}";
+  while (true) {
+    // Wait for commands between control ticks instead of sleeping, but wake up in time to end a
+    // solenoid pull-in pulse.
+    uint32_t pulseWait = solenoid.update(millis());
+    commandQueue.process(controller, min<uint32_t>(100, pulseWait) / portTICK_PERIOD_MS);
+
+    // Keep the moisture filter at a fixed sample rate regardless of the command rate.
+    if (millis() - sampleTimer >= 100) {
+      sampleTimer = millis();
+      controller.sampleMoisture(analogRead(moistureSensorPin));
+      rtcWateringUsage = controller.usage();
+
+      // Store runs that ended before the clock was set as soon as NTP has synced.
+      history.flushPending();
+    }
 
-  return message;
+    WateringEvent event;
+    uint32_t now = millis();
+    if (controller.update(now, event)) {
+      isWatering = event.action == VALVE_OPEN;
+      if (isWatering) {
+        solenoid.open(now);
+      } else {
+        solenoid.close(now);
+      }
+      commandQueue.valveSwitched();
+
+      if (isWatering) {
+        debug(SCS, "Watering plants in progress (%s)", wateringReasonName(event.reason));
+        deviceStatus = WATERING_MODE;
+        runTrigger = event.reason;
+      } else {
+        debug(SCS, "Watering plants complete (%s), average coil duty %u%%.", wateringReasonName(event.reason), solenoid.lastRunDuty());
+        deviceStatus = READY_TO_SEND;
+
+        // Record the finished run after the valve has already been closed.
+        controller.saveUsage();
+        history.appendRun(min<uint32_t>(event.durationMs / 1000, UINT16_MAX), 0, runTrigger);
+      }
+
+      // Drop the report rather than block the valve if the queue is full.
+      xQueueSend(wateringEventQueue, &event, 0);
+      if (localEventQueue != NULL) {
+        xQueueSend(localEventQueue, &event, 0);
+      }
+    }
+  }
 }
 
 /**
@@ -0,0 +1,235 @@
+/**
+* SolenoidDriver.cpp
+* Implementation of the peak-and-hold solenoid valve driver.
+*
+* This file contains the implementation for the SolenoidDriver class.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+#include "SolenoidDriver.h"
+#include "Helpers.h"
+
+/**
+* Constructs a SolenoidDriver object.
+*
+* @param pinA Output driving the coil, or the open side of the H-bridge for latching valves.
+* @param pinB Close side of the H-bridge for latching valves, -1 if not connected.
+*/
+SolenoidDriver::SolenoidDriver(int pinA, int pinB)
+  : _pinA(pinA),
+    _pinB(pinB),
+    _profile(SOLENOID_PROFILE_DIRECT),
+    _open(false),
+    _pulseActive(false),
+    _pulseStart(0),
+    _duty(0),
+    _dutyChange(0),
+    _runStart(0),
+    _dutyIntegral(0),
+    _lastRunDuty(0) {
+}
+
+/**
+* Attaches the outputs to LEDC and closes the valve.
+* A latching valve is switched closed with a blocking close pulse, so no task is needed to end it.
+*
+* @param profile Drive timing of the connected valve.
+* @return true if the profile can be driven on the given pins; false otherwise.
+*/
+bool SolenoidDriver::begin(const SolenoidProfile& profile) {
+  // A latching valve cannot be closed without the second half of the H-bridge.
+  if (profile.type == SOLENOID_LATCHING && _pinB < 0) {
+    _profile = SOLENOID_PROFILE_DIRECT;
+    attach(_pinA, SOLENOID_LEDC_CHANNEL_A);
+    write(_pinA, SOLENOID_LEDC_CHANNEL_A, 0);
+    return false;
+  }
+
+  _profile = profile;
+  _profile.holdDuty = min<uint8_t>(_profile.holdDuty, 100);
+
+  attach(_pinA, SOLENOID_LEDC_CHANNEL_A);
+  write(_pinA, SOLENOID_LEDC_CHANNEL_A, 0);
+
+  if (_pinB >= 0) {
+    attach(_pinB, SOLENOID_LEDC_CHANNEL_B);
+    write(_pinB, SOLENOID_LEDC_CHANNEL_B, 0);
+  }
+
+  // The state of a latching valve is unknown after boot, so switch it to closed. The pulse is
+  // ended here because the control task may start much later, or not at all in maintenance mode.
+  if (_profile.type == SOLENOID_LATCHING) {
+    _open = true;
+    close(millis());
+    delay(_profile.pulseMs);
+    setDuty(millis(), 0, 0);
+    _pulseActive = false;
+    _lastRunDuty = 0;
+  }
+
+  return true;
+}
+
+/**
+* Opens the valve and starts the pull-in pulse.
+*
+* @param now Current time in milliseconds.
+*/
+void SolenoidDriver::open(uint32_t now) {
+  if (_open) {
+    return;
+  }
+
+  _open = true;
+  _runStart = now;
+  _dutyChange = now;
+  _dutyIntegral = 0;
+
+  // Without a pull-in time the coil goes straight to the hold duty.
+  _pulseActive = _profile.pulseMs > 0;
+  _pulseStart = now;
+
+  if (_profile.type == SOLENOID_LATCHING) {
+    setDuty(now, _profile.reversePolarity ? 0 : 100, _profile.reversePolarity ? 100 : 0);
+    _dutyIntegral = (uint64_t)_profile.pulseMs * 100;
+  } else {
+    setDuty(now, _pulseActive ? 100 : _profile.holdDuty, 0);
+  }
+}
+
+/**
+* Closes the valve.
+* Latching valves get a close pulse in reverse polarity.
+*
+* @param now Current time in milliseconds.
+*/
+void SolenoidDriver::close(uint32_t now) {
+  if (!_open) {
+    return;
+  }
+
+  _open = false;
+
+  if (_profile.type == SOLENOID_LATCHING) {
+    // The close pulse is part of the run it ends.
+    setDuty(now, _profile.reversePolarity ? 100 : 0, _profile.reversePolarity ? 0 : 100);
+    _pulseActive = true;
+    _pulseStart = now;
+    _dutyIntegral += (uint64_t)_profile.pulseMs * 100;
+  } else {
+    setDuty(now, 0, 0);
+    _pulseActive = false;
+  }
+
+  uint32_t duration = now - _runStart;
+  _lastRunDuty = duration > 0 ? min<uint64_t>(_dutyIntegral / duration, 100) : 100;
+}
+
+/**
+* Ends the pull-in or switching pulse once it has elapsed.
+* This function must be called from the task that opens and closes the valve.
+*
+* @param now Current time in milliseconds.
+* @return Milliseconds until the next call is needed, UINT32_MAX if nothing is pending.
+*/
+uint32_t SolenoidDriver::update(uint32_t now) {
+  if (!_pulseActive) {
+    return UINT32_MAX;
+  }
+
+  uint32_t elapsed = now - _pulseStart;
+  if (elapsed < _profile.pulseMs) {
+    return _profile.pulseMs - elapsed;
+  }
+
+  _pulseActive = false;
+
+  // Monostable valves drop to the hold duty, latching valves are released entirely.
+  if (_profile.type == SOLENOID_MONOSTABLE && _open) {
+    setDuty(now, _profile.holdDuty, 0);
+  } else {
+    setDuty(now, 0, 0);
+  }
+
+  return UINT32_MAX;
+}
+
+/**
+* Returns whether the valve is open.
+*
+* @return true if the valve is open; false otherwise.
+*/
+bool SolenoidDriver::isOpen() const {
+  return _open;
+}
+
+/**
+* Returns the average coil duty of the last finished run.
+* Coil power is proportional to the duty, so 100 means the power of plain on/off drive.
+*
+* @return Average duty in percent.
+*/
+uint8_t SolenoidDriver::lastRunDuty() const {
+  return _lastRunDuty;
+}
+
+void SolenoidDriver::attach(int pin, uint8_t channel) {
+  // ESP32 Core changed the LEDC API in version 3.0.0, channels are allocated per pin since then.
+#if (VERSION_CHECK(ESP_ARDUINO_VERSION_MAJOR, ESP_ARDUINO_VERSION_MINOR, ESP_ARDUINO_VERSION_PATCH) < VERSION_CHECK(3, 0, 0))
+  ledcSetup(channel, SOLENOID_PWM_FREQUENCY, SOLENOID_PWM_RESOLUTION);
+  ledcAttachPin(pin, channel);
+#else
+  ledcAttach(pin, SOLENOID_PWM_FREQUENCY, SOLENOID_PWM_RESOLUTION);
+#endif
+}
+
+void SolenoidDriver::write(int pin, uint8_t channel, uint8_t duty) {
+  uint32_t value = (uint32_t)duty * ((1 << SOLENOID_PWM_RESOLUTION) - 1) / 100;
+
+#if (VERSION_CHECK(ESP_ARDUINO_VERSION_MAJOR, ESP_ARDUINO_VERSION_MINOR, ESP_ARDUINO_VERSION_PATCH) < VERSION_CHECK(3, 0, 0))
+  ledcWrite(channel, value);
+#else
+  ledcWrite(pin, value);
+#endif
+}
+
+void SolenoidDriver::setDuty(uint32_t now, uint8_t dutyA, uint8_t dutyB) {
+  // Integrate the coil duty of monostable runs, latching pulses are accounted when closing.
+  if (_profile.type == SOLENOID_MONOSTABLE) {
+    _dutyIntegral += (uint64_t)_duty * (now - _dutyChange);
+  }
+
+  _duty = max(dutyA, dutyB);
+  _dutyChange = now;
+
+  // Release before driving, so both H-bridge outputs are never high at the same time.
+  if (dutyA == 0) {
+    write(_pinA, SOLENOID_LEDC_CHANNEL_A, 0);
+  }
+  if (_pinB >= 0) {
+    write(_pinB, SOLENOID_LEDC_CHANNEL_B, dutyB);
+  }
+  if (dutyA > 0) {
+    write(_pinA, SOLENOID_LEDC_CHANNEL_A, dutyA);
+  }
+}
@@ -0,0 +1,143 @@
+/**
+* SolenoidDriver.h
+* Declaration of the peak-and-hold solenoid valve driver.
+*
+* This file contains the declaration for the SolenoidDriver class, which drives the solenoid valve
+* through the LEDC PWM peripheral. Monostable valves are pulled in at full duty and then held at a
+* reduced duty, which cuts the coil current for the rest of the run. Latching valves are switched
+* with a short pulse in either polarity through an H-bridge and draw no current while held.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef SOLENOID_DRIVER_H
+#define SOLENOID_DRIVER_H
+
+#include "Arduino.h"
+
+// PWM settings of the coil drive. 20 kHz keeps the coil inaudible.
+#define SOLENOID_PWM_FREQUENCY 20000
+#define SOLENOID_PWM_RESOLUTION 8
+
+// LEDC channels used on ESP32 core 2.x, where tone() already takes channel 0.
+#define SOLENOID_LEDC_CHANNEL_A 2
+#define SOLENOID_LEDC_CHANNEL_B 3
+
+// Enum to represent the valve types.
+enum SolenoidTypeEnum : byte {
+  SOLENOID_MONOSTABLE,  // Spring return valve, must be powered while open.
+  SOLENOID_LATCHING     // Bistable valve, switched by a pulse in either polarity.
+};
+
+// Struct to hold the drive timing of a valve.
+struct SolenoidProfile {
+  SolenoidTypeEnum type;  // Valve type.
+  uint16_t pulseMs;       // Full duty pull-in time, or switching pulse length of a latching valve.
+  uint8_t holdDuty;       // Hold duty in percent after pull-in, unused by latching valves.
+  bool reversePolarity;   // Swap the A and B outputs of a latching valve.
+};
+
+// Plain on/off drive, the coil is powered at full duty for the whole run.
+const SolenoidProfile SOLENOID_PROFILE_DIRECT = { SOLENOID_MONOSTABLE, 0, 100, false };
+
+// Typical 12 V monostable valve, pulled in for 150 ms and held at 35 % duty.
+const SolenoidProfile SOLENOID_PROFILE_PEAK_HOLD = { SOLENOID_MONOSTABLE, 150, 35, false };
+
+// Typical 9-12 V latching valve, switched by a 50 ms pulse.
+const SolenoidProfile SOLENOID_PROFILE_LATCHING = { SOLENOID_LATCHING, 50, 0, false };
+
+class SolenoidDriver {
+public:
+  /**
+  * Constructs a SolenoidDriver object.
+  *
+  * @param pinA Output driving the coil, or the open side of the H-bridge for latching valves.
+  * @param pinB Close side of the H-bridge for latching valves, -1 if not connected.
+  */
+  SolenoidDriver(int pinA, int pinB = -1);
+
+  /**
+  * Attaches the outputs to LEDC and closes the valve.
+  * A latching valve is switched closed with a blocking close pulse, so no task is needed to end it.
+  *
+  * @param profile Drive timing of the connected valve.
+  * @return true if the profile can be driven on the given pins; false otherwise.
+  */
+  bool begin(const SolenoidProfile& profile);
+
+  /**
+  * Opens the valve and starts the pull-in pulse.
+  *
+  * @param now Current time in milliseconds.
+  */
+  void open(uint32_t now);
+
+  /**
+  * Closes the valve.
+  * Latching valves get a close pulse in reverse polarity.
+  *
+  * @param now Current time in milliseconds.
+  */
+  void close(uint32_t now);
+
+  /**
+  * Ends the pull-in or switching pulse once it has elapsed.
+  * This function must be called from the task that opens and closes the valve.
+  *
+  * @param now Current time in milliseconds.
+  * @return Milliseconds until the next call is needed, UINT32_MAX if nothing is pending.
+  */
+  uint32_t update(uint32_t now);
+
+  /**
+  * Returns whether the valve is open.
+  *
+  * @return true if the valve is open; false otherwise.
+  */
+  bool isOpen() const;
+
+  /**
+  * Returns the average coil duty of the last finished run.
+  * Coil power is proportional to the duty, so 100 means the power of plain on/off drive.
+  *
+  * @return Average duty in percent.
+  */
+  uint8_t lastRunDuty() const;
+
+private:
+  void attach(int pin, uint8_t channel);
+  void write(int pin, uint8_t channel, uint8_t duty);
+  void setDuty(uint32_t now, uint8_t dutyA, uint8_t dutyB);
+
+  int _pinA;
+  int _pinB;
+  SolenoidProfile _profile;
+  bool _open;
+  bool _pulseActive;
+  uint32_t _pulseStart;
+  uint8_t _duty;           // Current coil duty in percent, either output.
+  uint32_t _dutyChange;    // Time of the last duty change.
+  uint32_t _runStart;      // Time the valve opened.
+  uint64_t _dutyIntegral;  // Duty percent times milliseconds since the valve opened.
+  uint8_t _lastRunDuty;
+};
+
+#endif
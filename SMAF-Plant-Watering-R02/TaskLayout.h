@@ -0,0 +1,134 @@
+/**
+* TaskLayout.h
+* Compile-time FreeRTOS task layout.
+*
+* This file defines the core and priority of the three application tasks: the network task (Wi-Fi,
+* MQTT I/O and publishing), the control task (command queue, watering controller and solenoid) and
+* the UI task (LED and audio notifications). Select one of the predefined layouts with TASK_LAYOUT,
+* or override single values with build flags, e.g. -DCONTROL_TASK_PRIORITY=5. The command-to-valve
+* latency reported in the status payload is tagged with the layout name to compare layouts.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef TASK_LAYOUT_H
+#define TASK_LAYOUT_H
+
+#include "Arduino.h"
+
+// Define constants for ESP32 core numbers.
+#define ESP32_CORE_PRIMARY 0    // Numeric value representing the primary core.
+#define ESP32_CORE_SECONDARY 1  // Numeric value representing the secondary core.
+
+// Predefined task layouts.
+#define TASK_LAYOUT_SPLIT 0    // Network next to the Wi-Fi stack, control and UI on the other core.
+#define TASK_LAYOUT_SHARED 1   // Every task on the secondary core, as the Arduino loop used to run.
+#define TASK_LAYOUT_CONTROL 2  // Control next to the Wi-Fi stack, network and UI on the other core.
+
+#ifndef TASK_LAYOUT
+#define TASK_LAYOUT TASK_LAYOUT_SPLIT
+#endif
+
+#if TASK_LAYOUT == TASK_LAYOUT_SPLIT
+#define TASK_LAYOUT_NAME "split"
+#define TASK_LAYOUT_NETWORK_CORE ESP32_CORE_PRIMARY
+#define TASK_LAYOUT_CONTROL_CORE ESP32_CORE_SECONDARY
+#define TASK_LAYOUT_UI_CORE ESP32_CORE_SECONDARY
+#elif TASK_LAYOUT == TASK_LAYOUT_SHARED
+#define TASK_LAYOUT_NAME "shared"
+#define TASK_LAYOUT_NETWORK_CORE ESP32_CORE_SECONDARY
+#define TASK_LAYOUT_CONTROL_CORE ESP32_CORE_SECONDARY
+#define TASK_LAYOUT_UI_CORE ESP32_CORE_SECONDARY
+#elif TASK_LAYOUT == TASK_LAYOUT_CONTROL
+#define TASK_LAYOUT_NAME "control"
+#define TASK_LAYOUT_NETWORK_CORE ESP32_CORE_SECONDARY
+#define TASK_LAYOUT_CONTROL_CORE ESP32_CORE_PRIMARY
+#define TASK_LAYOUT_UI_CORE ESP32_CORE_SECONDARY
+#else
+#error "Unknown TASK_LAYOUT."
+#endif
+
+// Single-core chips run every task on the only core.
+#if CONFIG_FREERTOS_UNICORE
+#undef TASK_LAYOUT_NETWORK_CORE
+#undef TASK_LAYOUT_CONTROL_CORE
+#undef TASK_LAYOUT_UI_CORE
+#define TASK_LAYOUT_NETWORK_CORE ESP32_CORE_PRIMARY
+#define TASK_LAYOUT_CONTROL_CORE ESP32_CORE_PRIMARY
+#define TASK_LAYOUT_UI_CORE ESP32_CORE_PRIMARY
+#endif
+
+// Network task, runs Wi-Fi and MQTT reconnects, mqtt.loop() and publishing.
+#ifndef NETWORK_TASK_CORE
+#define NETWORK_TASK_CORE TASK_LAYOUT_NETWORK_CORE
+#endif
+#ifndef NETWORK_TASK_PRIORITY
+#define NETWORK_TASK_PRIORITY 2
+#endif
+#ifndef NETWORK_TASK_STACK
+#define NETWORK_TASK_STACK 8000
+#endif
+
+// Time the network task sleeps between two polls of the MQTT client in milliseconds.
+#ifndef NETWORK_TASK_POLL_MS
+#define NETWORK_TASK_POLL_MS 2
+#endif
+
+// Control task, owns the command queue, the watering controller and the solenoid.
+#ifndef CONTROL_TASK_CORE
+#define CONTROL_TASK_CORE TASK_LAYOUT_CONTROL_CORE
+#endif
+#ifndef CONTROL_TASK_PRIORITY
+#define CONTROL_TASK_PRIORITY 3
+#endif
+#ifndef CONTROL_TASK_STACK
+#define CONTROL_TASK_STACK 4000
+#endif
+
+// UI task, drives the LED animations.
+#ifndef UI_TASK_CORE
+#define UI_TASK_CORE TASK_LAYOUT_UI_CORE
+#endif
+#ifndef UI_TASK_PRIORITY
+#define UI_TASK_PRIORITY 1
+#endif
+#ifndef UI_TASK_STACK
+#define UI_TASK_STACK 8000
+#endif
+
+// Local API task, builds the local snapshots and feeds the local WebSocket clients.
+// It shares the core of the network task and runs below it, so local clients never delay MQTT.
+#ifndef LOCAL_API_TASK_CORE
+#define LOCAL_API_TASK_CORE NETWORK_TASK_CORE
+#endif
+#ifndef LOCAL_API_TASK_PRIORITY
+#define LOCAL_API_TASK_PRIORITY 1
+#endif
+#ifndef LOCAL_API_TASK_STACK
+#define LOCAL_API_TASK_STACK 4000
+#endif
+
+// Longest time the local API task sleeps between two client updates in milliseconds.
+#ifndef LOCAL_API_TASK_POLL_MS
+#define LOCAL_API_TASK_POLL_MS 20
+#endif
+
+#endif
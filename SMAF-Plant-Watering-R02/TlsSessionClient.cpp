@@ -0,0 +1,507 @@
+/**
+* TlsSessionClient.cpp
+* Implementation of a TLS client with session resumption for MQTT.
+*
+* This file contains the implementation for the TlsSessionClient class. mbedTLS reads and writes
+* through the wrapped WiFiClient using non-blocking BIO callbacks.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+#include "TlsSessionClient.h"
+#include "Helpers.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/version.h"
+#include "mbedtls/net_sockets.h"
+
+#define TLS_SESSION_MAGIC 0x544C5332UL  // "TLS2"
+
+// Session cache that survives software resets (watchdog, ESP.restart) but not power loss.
+struct TlsSessionCache {
+  uint32_t magic;
+  uint32_t checksum;
+  uint32_t key;  // Host and pinned trust anchor the session was negotiated with.
+  uint16_t length;
+  char host[64];
+  uint8_t data[TLS_SESSION_CACHE_SIZE];
+};
+
+static RTC_NOINIT_ATTR TlsSessionCache tlsSessionCache;
+
+static uint32_t fnv1a(uint32_t hash, const uint8_t* bytes, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ bytes[i]) * 16777619UL;
+  }
+
+  return hash;
+}
+
+static uint32_t tlsSessionChecksum(const TlsSessionCache& cache) {
+  // FNV-1a over host and session data.
+  if (cache.length > TLS_SESSION_CACHE_SIZE) {
+    return 0;
+  }
+
+  uint32_t hash = fnv1a(2166136261UL, (const uint8_t*)cache.host, sizeof(cache.host) + cache.length);
+  return hash ^ cache.length ^ cache.key;
+}
+
+/**
+* Constructs a TlsSessionClient object.
+* Call setCACert() or setFingerprint() before connecting.
+*/
+TlsSessionClient::TlsSessionClient()
+  : _caCert(nullptr),
+    _hasFingerprint(false),
+    _hasSession(false),
+    _sessionKey(0),
+    _seeded(false),
+    _connected(false),
+    _peeked(-1),
+    _handshakeTime(0),
+    _handshakeResumable(false) {
+  mbedtls_ssl_init(&_ssl);
+  mbedtls_ssl_config_init(&_conf);
+  mbedtls_entropy_init(&_entropy);
+  mbedtls_ctr_drbg_init(&_drbg);
+  mbedtls_x509_crt_init(&_ca);
+  mbedtls_ssl_session_init(&_session);
+  memset(_fingerprint, 0, sizeof(_fingerprint));
+}
+
+TlsSessionClient::~TlsSessionClient() {
+  stop();
+  mbedtls_ssl_session_free(&_session);
+  mbedtls_x509_crt_free(&_ca);
+  mbedtls_ssl_config_free(&_conf);
+  mbedtls_ctr_drbg_free(&_drbg);
+  mbedtls_entropy_free(&_entropy);
+}
+
+/**
+* Pins the CA certificate used to verify the server.
+*
+* @param caCert PEM encoded CA certificate. Must stay valid until the next connect.
+*/
+void TlsSessionClient::setCACert(const char* caCert) {
+  _caCert = isEmpty(caCert) ? nullptr : caCert;
+}
+
+/**
+* Pins the SHA-256 fingerprint of the server certificate.
+* Used when no CA certificate is configured.
+*
+* @param fingerprint 64 hex characters, optionally separated by colons.
+* @return true if the fingerprint could be parsed; false otherwise.
+*/
+bool TlsSessionClient::setFingerprint(const char* fingerprint) {
+  size_t count = 0;
+  _hasFingerprint = false;
+
+  for (const char* c = fingerprint; c != nullptr && *c != '\0' && count < 64; c++) {
+    if (*c == ':' || *c == ' ') {
+      continue;
+    }
+    if (!isxdigit(*c)) {
+      return false;
+    }
+
+    uint8_t nibble = isdigit(*c) ? *c - '0' : (tolower(*c) - 'a' + 10);
+    _fingerprint[count / 2] = (count % 2 == 0) ? nibble << 4 : _fingerprint[count / 2] | nibble;
+    count++;
+  }
+
+  _hasFingerprint = count == 64;
+  return _hasFingerprint;
+}
+
+/**
+* Drops the cached session in RAM and in RTC memory.
+*/
+void TlsSessionClient::clearSession() {
+  mbedtls_ssl_session_free(&_session);
+  mbedtls_ssl_session_init(&_session);
+  _hasSession = false;
+  tlsSessionCache.magic = 0;
+}
+
+/**
+* Returns the duration of the last TLS handshake.
+*
+* @return Handshake duration in milliseconds.
+*/
+uint32_t TlsSessionClient::lastHandshakeTime() const {
+  return _handshakeTime;
+}
+
+/**
+* Returns whether the last handshake offered a cached session to the server.
+*
+* @return true if a cached session was offered; false otherwise.
+*/
+bool TlsSessionClient::lastHandshakeResumable() const {
+  return _handshakeResumable;
+}
+
+int TlsSessionClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip.toString().c_str(), port, TLS_HANDSHAKE_TIMEOUT);
+}
+
+int TlsSessionClient::connect(const char* host, uint16_t port) {
+  return connect(host, port, TLS_HANDSHAKE_TIMEOUT);
+}
+
+int TlsSessionClient::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+  return connect(ip.toString().c_str(), port, timeout);
+}
+
+int TlsSessionClient::connect(const char* host, uint16_t port, int32_t timeout) {
+  stop();
+
+  if (!setupContext()) {
+    return 0;
+  }
+
+  if (!_tcp.connect(host, port, timeout)) {
+    return 0;
+  }
+
+  if (!handshake(host, timeout)) {
+    debug(ERR, "TLS handshake with '%s' failed.", host);
+    stop();
+    return 0;
+  }
+
+  _connected = true;
+  return 1;
+}
+
+size_t TlsSessionClient::write(uint8_t data) {
+  return write(&data, 1);
+}
+
+size_t TlsSessionClient::write(const uint8_t* buf, size_t size) {
+  size_t written = 0;
+  uint32_t progress = millis();
+
+  while (_connected && written < size) {
+    int result = mbedtls_ssl_write(&_ssl, buf + written, size - written);
+
+    if (result > 0) {
+      written += result;
+      progress = millis();
+    } else if (result != MBEDTLS_ERR_SSL_WANT_READ && result != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      stop();
+      break;
+    } else if (millis() - progress >= TLS_WRITE_TIMEOUT) {
+      // The socket stopped draining. Drop the connection so the caller reconnects.
+      debug(ERR, "TLS write stalled for %u ms, closing the connection.", (unsigned int)TLS_WRITE_TIMEOUT);
+      stop();
+      break;
+    } else {
+      delay(1);
+    }
+  }
+
+  return written;
+}
+
+int TlsSessionClient::available() {
+  if (!_connected) {
+    return 0;
+  }
+
+  int pending = mbedtls_ssl_get_bytes_avail(&_ssl);
+
+  // Let mbedTLS decrypt the next record if raw bytes are waiting on the socket.
+  if (pending == 0 && _tcp.available() > 0) {
+    int result = mbedtls_ssl_read(&_ssl, nullptr, 0);
+
+    if (result < 0 && result != MBEDTLS_ERR_SSL_WANT_READ && result != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      stop();
+      return 0;
+    }
+
+    pending = mbedtls_ssl_get_bytes_avail(&_ssl);
+  }
+
+  return pending + (_peeked >= 0 ? 1 : 0);
+}
+
+int TlsSessionClient::read() {
+  uint8_t data;
+  return read(&data, 1) == 1 ? data : -1;
+}
+
+int TlsSessionClient::read(uint8_t* buf, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+
+  size_t offset = 0;
+  if (_peeked >= 0) {
+    buf[offset++] = _peeked;
+    _peeked = -1;
+  }
+
+  if (offset < size && available() > 0) {
+    int result = mbedtls_ssl_read(&_ssl, buf + offset, size - offset);
+
+    if (result > 0) {
+      offset += result;
+    } else if (result != MBEDTLS_ERR_SSL_WANT_READ && result != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      stop();
+    }
+  }
+
+  return offset > 0 ? offset : -1;
+}
+
+int TlsSessionClient::peek() {
+  if (_peeked < 0) {
+    uint8_t data;
+    if (available() > 0 && mbedtls_ssl_read(&_ssl, &data, 1) == 1) {
+      _peeked = data;
+    }
+  }
+
+  return _peeked;
+}
+
+void TlsSessionClient::flush() {
+  _tcp.flush();
+}
+
+void TlsSessionClient::stop() {
+  if (_connected) {
+    mbedtls_ssl_close_notify(&_ssl);
+  }
+
+  _connected = false;
+  _peeked = -1;
+  mbedtls_ssl_free(&_ssl);
+  mbedtls_ssl_init(&_ssl);
+  _tcp.stop();
+}
+
+uint8_t TlsSessionClient::connected() {
+  if (_connected && !_tcp.connected() && mbedtls_ssl_get_bytes_avail(&_ssl) == 0) {
+    stop();
+  }
+
+  return _connected;
+}
+
+TlsSessionClient::operator bool() {
+  return connected();
+}
+
+bool TlsSessionClient::setupContext() {
+  if (!_seeded) {
+    const char* personalization = "smaf-tls";
+
+    if (mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy, (const unsigned char*)personalization, strlen(personalization)) != 0) {
+      return false;
+    }
+
+    if (mbedtls_ssl_config_defaults(&_conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+      return false;
+    }
+
+    mbedtls_ssl_conf_rng(&_conf, mbedtls_ctr_drbg_random, &_drbg);
+
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+    // Session export is only reliable once per connection with TLS 1.2.
+    mbedtls_ssl_conf_max_tls_version(&_conf, MBEDTLS_SSL_VERSION_TLS1_2);
+#endif
+
+#ifdef MBEDTLS_SSL_SESSION_TICKETS
+    mbedtls_ssl_conf_session_tickets(&_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+    _seeded = true;
+  }
+
+  // Verify against the pinned CA, or check the fingerprint after the handshake.
+  mbedtls_x509_crt_free(&_ca);
+  mbedtls_x509_crt_init(&_ca);
+
+  if (_caCert != nullptr) {
+    if (mbedtls_x509_crt_parse(&_ca, (const unsigned char*)_caCert, strlen(_caCert) + 1) != 0) {
+      debug(ERR, "TLS CA certificate could not be parsed.");
+      return false;
+    }
+
+    mbedtls_ssl_conf_ca_chain(&_conf, &_ca, nullptr);
+    mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+  } else if (_hasFingerprint) {
+    mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_NONE);
+  } else {
+    debug(ERR, "TLS requires a CA certificate or a fingerprint.");
+    return false;
+  }
+
+  return mbedtls_ssl_setup(&_ssl, &_conf) == 0;
+}
+
+bool TlsSessionClient::handshake(const char* host, int32_t timeout) {
+  if (mbedtls_ssl_set_hostname(&_ssl, host) != 0) {
+    return false;
+  }
+
+  mbedtls_ssl_set_bio(&_ssl, this, sendCallback, receiveCallback, nullptr);
+
+  // Offer the cached session to skip the certificate exchange and key agreement.
+  _handshakeResumable = restoreSession(host) && mbedtls_ssl_set_session(&_ssl, &_session) == 0;
+
+  uint32_t start = millis();
+  int result;
+
+  while ((result = mbedtls_ssl_handshake(&_ssl)) != 0) {
+    if (result != MBEDTLS_ERR_SSL_WANT_READ && result != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      // A rejected or corrupt session must not be offered again.
+      clearSession();
+      return false;
+    }
+
+    if (millis() - start >= (uint32_t)timeout || !_tcp.connected()) {
+      return false;
+    }
+
+    delay(2);
+  }
+
+  _handshakeTime = millis() - start;
+
+  if (_caCert == nullptr && !verifyFingerprint()) {
+    debug(ERR, "TLS server certificate fingerprint mismatch.");
+    clearSession();
+    return false;
+  }
+
+  storeSession(host);
+  return true;
+}
+
+bool TlsSessionClient::verifyFingerprint() {
+  const mbedtls_x509_crt* peer = mbedtls_ssl_get_peer_cert(&_ssl);
+  uint8_t digest[32];
+
+  if (peer == nullptr) {
+    return false;
+  }
+
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+  mbedtls_sha256(peer->raw.p, peer->raw.len, digest, 0);
+#else
+  mbedtls_sha256_ret(peer->raw.p, peer->raw.len, digest, 0);
+#endif
+
+  return memcmp(digest, _fingerprint, sizeof(digest)) == 0;
+}
+
+uint32_t TlsSessionClient::sessionKey(const char* host) const {
+  // A session is only valid for the server it was negotiated with under the same trust anchor.
+  uint32_t hash = fnv1a(2166136261UL, (const uint8_t*)host, strlen(host) + 1);
+
+  if (_caCert != nullptr) {
+    return fnv1a(hash, (const uint8_t*)_caCert, strlen(_caCert));
+  }
+
+  return fnv1a(hash, _fingerprint, sizeof(_fingerprint));
+}
+
+void TlsSessionClient::storeSession(const char* host) {
+  mbedtls_ssl_session_free(&_session);
+  mbedtls_ssl_session_init(&_session);
+  _hasSession = mbedtls_ssl_get_session(&_ssl, &_session) == 0;
+  _sessionKey = sessionKey(host);
+
+  if (!_hasSession) {
+    return;
+  }
+
+  // Mirror the session into RTC memory so that a software reboot can resume it too.
+  size_t length = 0;
+  int result = mbedtls_ssl_session_save(&_session, tlsSessionCache.data, sizeof(tlsSessionCache.data), &length);
+  if (result == 0) {
+    memset(tlsSessionCache.host, 0, sizeof(tlsSessionCache.host));
+    strncpy(tlsSessionCache.host, host, sizeof(tlsSessionCache.host) - 1);
+    tlsSessionCache.key = _sessionKey;
+    tlsSessionCache.length = length;
+    tlsSessionCache.checksum = tlsSessionChecksum(tlsSessionCache);
+    tlsSessionCache.magic = TLS_SESSION_MAGIC;
+  } else {
+    // The session still resumes from RAM, only a reboot falls back to a full handshake.
+    tlsSessionCache.magic = 0;
+    if (result == MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL) {
+      debug(ERR, "TLS session needs %u bytes, RTC cache holds %u. Raise TLS_SESSION_CACHE_SIZE.", (unsigned int)length, (unsigned int)TLS_SESSION_CACHE_SIZE);
+    } else {
+      debug(ERR, "TLS session could not be saved to RTC memory (-0x%04X).", (unsigned int)-result);
+    }
+  }
+}
+
+bool TlsSessionClient::restoreSession(const char* host) {
+  uint32_t key = sessionKey(host);
+
+  if (_hasSession && _sessionKey == key) {
+    return true;
+  }
+
+  // Never offer a session negotiated with another host, CA certificate or fingerprint.
+  mbedtls_ssl_session_free(&_session);
+  mbedtls_ssl_session_init(&_session);
+  _hasSession = false;
+
+  bool cached = tlsSessionCache.magic == TLS_SESSION_MAGIC && tlsSessionCache.length <= TLS_SESSION_CACHE_SIZE && tlsSessionCache.checksum == tlsSessionChecksum(tlsSessionCache) && tlsSessionCache.key == key && strncmp(tlsSessionCache.host, host, sizeof(tlsSessionCache.host)) == 0;
+
+  if (!cached) {
+    return false;
+  }
+
+  // Reload from RTC memory after a reboot.
+  _hasSession = mbedtls_ssl_session_load(&_session, tlsSessionCache.data, tlsSessionCache.length) == 0;
+  _sessionKey = key;
+  return _hasSession;
+}
+
+int TlsSessionClient::sendCallback(void* ctx, const unsigned char* buf, size_t len) {
+  TlsSessionClient* client = static_cast<TlsSessionClient*>(ctx);
+
+  if (!client->_tcp.connected()) {
+    return MBEDTLS_ERR_NET_CONN_RESET;
+  }
+
+  size_t written = client->_tcp.write(buf, len);
+  return written > 0 ? (int)written : MBEDTLS_ERR_SSL_WANT_WRITE;
+}
+
+int TlsSessionClient::receiveCallback(void* ctx, unsigned char* buf, size_t len) {
+  TlsSessionClient* client = static_cast<TlsSessionClient*>(ctx);
+
+  if (client->_tcp.available() > 0) {
+    return client->_tcp.read(buf, len);
+  }
+
+  return client->_tcp.connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+}
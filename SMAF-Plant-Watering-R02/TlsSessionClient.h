@@ -0,0 +1,150 @@
+/**
+* TlsSessionClient.h
+* Declaration of a TLS client with session resumption for MQTT.
+*
+* This file contains the declaration for the TlsSessionClient class, an Arduino Client that runs
+* mbedTLS on top of a plain WiFiClient. The server is authenticated either against a pinned CA
+* certificate or against the SHA-256 fingerprint of its certificate. After every full handshake the
+* negotiated session (session ID or session ticket) is cached in RAM and in RTC memory, so that
+* reconnects and software reboots resume the session instead of repeating the full handshake.
+* The cached session is keyed on the host and on the pinned CA certificate or fingerprint.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef TLS_SESSION_CLIENT_H
+#define TLS_SESSION_CLIENT_H
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+
+// Size of the serialized session kept in RTC memory.
+// With MBEDTLS_SSL_KEEP_PEER_CERTIFICATE (the ESP-IDF default) the session carries the server
+// certificate in DER form, so leave room for a typical leaf certificate.
+#ifndef TLS_SESSION_CACHE_SIZE
+#if defined(MBEDTLS_SSL_KEEP_PEER_CERTIFICATE)
+#define TLS_SESSION_CACHE_SIZE 2048
+#else
+#define TLS_SESSION_CACHE_SIZE 640
+#endif
+#endif
+
+// Default TLS handshake timeout in milliseconds.
+#define TLS_HANDSHAKE_TIMEOUT 10000
+
+// Time in milliseconds a write may wait for the socket without progress before the connection is dropped.
+#ifndef TLS_WRITE_TIMEOUT
+#define TLS_WRITE_TIMEOUT 5000
+#endif
+
+class TlsSessionClient : public Client {
+public:
+  /**
+  * Constructs a TlsSessionClient object.
+  * Call setCACert() or setFingerprint() before connecting.
+  */
+  TlsSessionClient();
+  ~TlsSessionClient();
+
+  /**
+  * Pins the CA certificate used to verify the server.
+  *
+  * @param caCert PEM encoded CA certificate. Must stay valid until the next connect.
+  */
+  void setCACert(const char* caCert);
+
+  /**
+  * Pins the SHA-256 fingerprint of the server certificate.
+  * Used when no CA certificate is configured.
+  *
+  * @param fingerprint 64 hex characters, optionally separated by colons.
+  * @return true if the fingerprint could be parsed; false otherwise.
+  */
+  bool setFingerprint(const char* fingerprint);
+
+  /**
+  * Drops the cached session in RAM and in RTC memory.
+  */
+  void clearSession();
+
+  /**
+  * Returns the duration of the last TLS handshake.
+  *
+  * @return Handshake duration in milliseconds.
+  */
+  uint32_t lastHandshakeTime() const;
+
+  /**
+  * Returns whether the last handshake offered a cached session to the server.
+  *
+  * @return true if a cached session was offered; false otherwise.
+  */
+  bool lastHandshakeResumable() const;
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  int connect(IPAddress ip, uint16_t port, int32_t timeout) override;
+  int connect(const char* host, uint16_t port, int32_t timeout) override;
+  size_t write(uint8_t data) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override;
+
+private:
+  bool setupContext();
+  bool handshake(const char* host, int32_t timeout);
+  bool verifyFingerprint();
+  uint32_t sessionKey(const char* host) const;
+  void storeSession(const char* host);
+  bool restoreSession(const char* host);
+  static int sendCallback(void* ctx, const unsigned char* buf, size_t len);
+  static int receiveCallback(void* ctx, unsigned char* buf, size_t len);
+
+  WiFiClient _tcp;
+  mbedtls_ssl_context _ssl;
+  mbedtls_ssl_config _conf;
+  mbedtls_entropy_context _entropy;
+  mbedtls_ctr_drbg_context _drbg;
+  mbedtls_x509_crt _ca;
+  mbedtls_ssl_session _session;
+  const char* _caCert;
+  uint8_t _fingerprint[32];
+  bool _hasFingerprint;
+  bool _hasSession;
+  uint32_t _sessionKey;
+  bool _seeded;
+  bool _connected;
+  int _peeked;
+  uint32_t _handshakeTime;
+  bool _handshakeResumable;
+};
+
+#endif
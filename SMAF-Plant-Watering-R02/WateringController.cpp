@@ -0,0 +1,461 @@
+/**
+* WateringController.cpp
+* Implementation of the closed-loop watering controller.
+*
+* This file contains the implementation for the WateringController class, which decides when the
+* solenoid valve should open or close based on the filtered soil moisture signal.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+#include "WateringController.h"
+#include <Preferences.h>
+
+#define WATERING_USAGE_MAGIC 0x57555331UL  // "WUS1"
+
+static uint32_t wateringUsageChecksum(const WateringUsage& usage) {
+  // FNV-1a over everything but the checksum itself.
+  uint32_t hash = 2166136261UL;
+  const uint8_t* bytes = (const uint8_t*)&usage;
+  size_t length = (const uint8_t*)&usage.checksum - bytes;
+
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ bytes[i]) * 16777619UL;
+  }
+
+  return hash;
+}
+
+/**
+* Constructs a WateringController object with default parameters.
+* Automatic control is disabled until parameters are loaded or pushed by the broker.
+*/
+WateringController::WateringController()
+  : _params{ false, 350, 550, 120, 600, 1000, 5000, 3000, 1200, 3 },
+    _state(IDLE),
+    _valveOpen(false),
+    _manualActive(false),
+    _manualPending(false),
+    _manualOpen(false),
+    _hasSample(false),
+    _filtered(0),
+    _runStart(0),
+    _soakStart(0),
+    _lastChange(0),
+    _lastAccount(0),
+    _bucketElapsed(0),
+    _openMs{},
+    _bucket(0) {
+}
+
+/**
+* Loads the controller parameters from preferences.
+* Missing keys fall back to the default parameters.
+*/
+void WateringController::loadParams() {
+  Preferences prefs;
+  WateringParams params = _params;
+
+  prefs.begin("controller", true);  // read-only
+  params.enabled = prefs.getBool("enabled", params.enabled);
+  params.dryThreshold = prefs.getUShort("dry", params.dryThreshold);
+  params.wetThreshold = prefs.getUShort("wet", params.wetThreshold);
+  params.maxRunSeconds = prefs.getULong("maxRun", params.maxRunSeconds);
+  params.soakSeconds = prefs.getULong("soak", params.soakSeconds);
+  params.flowRate = prefs.getULong("flowRate", params.flowRate);
+  params.dailyCap = prefs.getULong("dailyCap", params.dailyCap);
+  params.sensorDryRaw = prefs.getUShort("sensorDry", params.sensorDryRaw);
+  params.sensorWetRaw = prefs.getUShort("sensorWet", params.sensorWetRaw);
+  params.filterShift = prefs.getUChar("filter", params.filterShift);
+  prefs.end();
+
+  setParams(params);
+}
+
+/**
+* Stores the current controller parameters to preferences.
+*/
+void WateringController::saveParams() {
+  Preferences prefs;
+
+  prefs.begin("controller", false);
+  prefs.putBool("enabled", _params.enabled);
+  prefs.putUShort("dry", _params.dryThreshold);
+  prefs.putUShort("wet", _params.wetThreshold);
+  prefs.putULong("maxRun", _params.maxRunSeconds);
+  prefs.putULong("soak", _params.soakSeconds);
+  prefs.putULong("flowRate", _params.flowRate);
+  prefs.putULong("dailyCap", _params.dailyCap);
+  prefs.putUShort("sensorDry", _params.sensorDryRaw);
+  prefs.putUShort("sensorWet", _params.sensorWetRaw);
+  prefs.putUChar("filter", _params.filterShift);
+  prefs.end();
+}
+
+/**
+* Returns a snapshot of the day window, to be kept across restarts.
+*
+* @return The day window with its magic and checksum set.
+*/
+WateringUsage WateringController::usage() const {
+  WateringUsage usage;
+  memset(&usage, 0, sizeof(usage));
+
+  usage.magic = WATERING_USAGE_MAGIC;
+  usage.bucketElapsedMs = _bucketElapsed;
+  memcpy(usage.openMs, _openMs, sizeof(usage.openMs));
+  usage.bucket = _bucket;
+  usage.checksum = wateringUsageChecksum(usage);
+
+  return usage;
+}
+
+/**
+* Restores the day window saved before a restart.
+* The time the device was off is unknown, so the window continues where it stopped. That keeps
+* the cap in force through reboot loops at the cost of counting old runs slightly longer.
+*
+* @param usage A snapshot returned by usage().
+* @return true if the snapshot was valid and restored; false otherwise.
+*/
+bool WateringController::restoreUsage(const WateringUsage& usage) {
+  if (usage.magic != WATERING_USAGE_MAGIC || usage.checksum != wateringUsageChecksum(usage) || usage.bucket >= WATERING_USAGE_BUCKETS || usage.bucketElapsedMs >= WATERING_BUCKET_MS) {
+    return false;
+  }
+
+  _bucketElapsed = usage.bucketElapsedMs;
+  memcpy(_openMs, usage.openMs, sizeof(_openMs));
+  _bucket = usage.bucket;
+  return true;
+}
+
+/**
+* Restores the day window from preferences, if one was stored.
+*
+* @return true if a stored window was restored; false otherwise.
+*/
+bool WateringController::loadUsage() {
+  Preferences prefs;
+  WateringUsage stored;
+
+  prefs.begin("controller", true);  // read-only
+  bool found = prefs.getBytes("usage", &stored, sizeof(stored)) == sizeof(stored);
+  prefs.end();
+
+  return found && restoreUsage(stored);
+}
+
+/**
+* Stores the day window to preferences. Call at the end of a run, not on every tick.
+*/
+void WateringController::saveUsage() {
+  Preferences prefs;
+  WateringUsage snapshot = usage();
+
+  prefs.begin("controller", false);
+  prefs.putBytes("usage", &snapshot, sizeof(snapshot));
+  prefs.end();
+}
+
+/**
+* Replaces the controller parameters.
+* Thresholds are sanitized so that the wet threshold is always above the dry threshold.
+*
+* @param params The new controller parameters.
+*/
+void WateringController::setParams(const WateringParams& params) {
+  WateringParams sanitized = params;
+
+  sanitized.dryThreshold = min<uint16_t>(sanitized.dryThreshold, 999);
+  sanitized.wetThreshold = constrain(sanitized.wetThreshold, sanitized.dryThreshold + 1, 1000);
+  sanitized.maxRunSeconds = max<uint32_t>(sanitized.maxRunSeconds, 1);
+  sanitized.filterShift = min<uint8_t>(sanitized.filterShift, 8);
+
+  // Keep the calibration range non-empty to avoid division by zero.
+  if (sanitized.sensorDryRaw == sanitized.sensorWetRaw) {
+    sanitized.sensorWetRaw = sanitized.sensorDryRaw > 0 ? sanitized.sensorDryRaw - 1 : 1;
+  }
+
+  _params = sanitized;
+}
+
+/**
+* Returns the current controller parameters.
+*
+* @return Reference to the current controller parameters.
+*/
+const WateringParams& WateringController::params() const {
+  return _params;
+}
+
+/**
+* Feeds a raw ADC sample into the moisture filter.
+* The sample is mapped to permille using the sensor calibration and smoothed with an exponential moving average.
+*
+* @param raw The raw ADC reading of the moisture sensor.
+* @return The filtered moisture in permille (0 = dry, 1000 = wet).
+*/
+uint16_t WateringController::sampleMoisture(uint16_t raw) {
+  // Capacitive sensors read lower values in wet soil, so the map works in both directions.
+  int32_t permille = map(raw, _params.sensorDryRaw, _params.sensorWetRaw, 0, 1000);
+  permille = constrain(permille, 0, 1000) * 16;
+
+  if (!_hasSample) {
+    _filtered = permille;
+    _hasSample = true;
+  } else {
+    _filtered += (permille - _filtered) >> _params.filterShift;
+  }
+
+  return moisture();
+}
+
+/**
+* Returns the last filtered moisture value.
+*
+* @return The filtered moisture in permille.
+*/
+uint16_t WateringController::moisture() const {
+  return _filtered / 16;
+}
+
+/**
+* Requests a manual valve state from the broker.
+* The request is applied on the next call to update().
+*
+* @param open True to open the valve, false to close it.
+*/
+void WateringController::requestManual(bool open) {
+  _manualOpen = open;
+  _manualPending = true;
+}
+
+/**
+* Runs the control state machine.
+* This function must be called periodically from a single task that owns the valve.
+*
+* @param now Current time in milliseconds.
+* @param event Filled with the decision if the valve state changed.
+* @return true if the valve state changed; false otherwise.
+*/
+bool WateringController::update(uint32_t now, WateringEvent& event) {
+  accumulate(now);
+
+  uint16_t current = moisture();
+  bool capReached = volumeToday() >= _params.dailyCap;
+
+  // Manual commands take precedence over automatic control, within the run time and daily cap.
+  if (_manualPending) {
+    _manualPending = false;
+    bool open = _manualOpen;
+
+    if (open && !_valveOpen) {
+      if (capReached) {
+        return false;
+      }
+
+      _manualActive = true;
+      openValve(now, REASON_MANUAL, event);
+      return true;
+    }
+
+    // A manual stop holds the valve closed for one soak period before automatic control resumes.
+    if (!open && _valveOpen) {
+      _manualActive = false;
+      closeValve(now, REASON_MANUAL, SOAKING, event);
+      return true;
+    }
+
+    _manualActive = open && _valveOpen;
+    return false;
+  }
+
+  if (_manualActive) {
+    if (capReached) {
+      _manualActive = false;
+      closeValve(now, REASON_DAILY_CAP, IDLE, event);
+      return true;
+    }
+
+    if (now - _runStart >= _params.maxRunSeconds * 1000UL) {
+      _manualActive = false;
+      closeValve(now, REASON_CYCLE_END, SOAKING, event);
+      return true;
+    }
+
+    return false;
+  }
+
+  switch (_state) {
+    case IDLE:
+      if (_params.enabled && _hasSample && current < _params.dryThreshold && !capReached) {
+        openValve(now, REASON_DRY, event);
+        return true;
+      }
+      break;
+    case WATERING:
+      if (!_params.enabled) {
+        closeValve(now, REASON_DISABLED, IDLE, event);
+        return true;
+      }
+      if (current >= _params.wetThreshold) {
+        closeValve(now, REASON_WET, IDLE, event);
+        return true;
+      }
+      if (capReached) {
+        closeValve(now, REASON_DAILY_CAP, IDLE, event);
+        return true;
+      }
+      if (now - _runStart >= _params.maxRunSeconds * 1000UL) {
+        closeValve(now, REASON_CYCLE_END, SOAKING, event);
+        return true;
+      }
+      break;
+    case SOAKING:
+      // Between cycles the wet threshold is the target, which gives the hysteresis band.
+      if (!_params.enabled || current >= _params.wetThreshold || capReached) {
+        _state = IDLE;
+      } else if (now - _soakStart >= _params.soakSeconds * 1000UL) {
+        openValve(now, REASON_CYCLE_RESUME, event);
+        return true;
+      }
+      break;
+  }
+
+  return false;
+}
+
+/**
+* Returns whether the controller wants the valve to be open.
+*
+* @return true if the valve should be open; false otherwise.
+*/
+bool WateringController::isValveOpen() const {
+  return _valveOpen;
+}
+
+/**
+* Returns the time of the last valve state change.
+*
+* @return Time in milliseconds, as passed to update().
+*/
+uint32_t WateringController::lastValveChange() const {
+  return _lastChange;
+}
+
+/**
+* Returns the volume delivered in the current day window.
+*
+* @return Volume in milliliters.
+*/
+uint32_t WateringController::volumeToday() const {
+  uint32_t openMs = 0;
+
+  for (uint8_t i = 0; i < WATERING_USAGE_BUCKETS; i++) {
+    openMs += _openMs[i];
+  }
+
+  return (uint64_t)openMs * _params.flowRate / 60000UL;
+}
+
+void WateringController::openValve(uint32_t now, WateringReasonEnum reason, WateringEvent& event) {
+  _valveOpen = true;
+  _state = WATERING;
+  _runStart = now;
+  _lastChange = now;
+
+  event.action = VALVE_OPEN;
+  event.reason = reason;
+  event.moisture = moisture();
+  event.durationMs = 0;
+  event.volumeToday = volumeToday();
+}
+
+void WateringController::closeValve(uint32_t now, WateringReasonEnum reason, StateEnum nextState, WateringEvent& event) {
+  _valveOpen = false;
+  _state = nextState;
+  _soakStart = now;
+  _lastChange = now;
+
+  event.action = VALVE_CLOSE;
+  event.reason = reason;
+  event.moisture = moisture();
+  event.durationMs = now - _runStart;
+  event.volumeToday = volumeToday();
+}
+
+void WateringController::accumulate(uint32_t now) {
+  uint32_t elapsed = now - _lastAccount;
+  _lastAccount = now;
+
+  // A gap longer than the window leaves nothing of it.
+  if (elapsed >= WATERING_DAY_MS) {
+    memset(_openMs, 0, sizeof(_openMs));
+    _bucketElapsed = 0;
+    elapsed = 0;
+  }
+
+  // Roll the window hour by hour, so the cap always covers the last 24 h.
+  while (elapsed > 0) {
+    uint32_t step = min<uint32_t>(elapsed, WATERING_BUCKET_MS - _bucketElapsed);
+
+    if (_valveOpen) {
+      _openMs[_bucket] += step;
+    }
+
+    _bucketElapsed += step;
+    elapsed -= step;
+
+    if (_bucketElapsed >= WATERING_BUCKET_MS) {
+      _bucket = (_bucket + 1) % WATERING_USAGE_BUCKETS;
+      _openMs[_bucket] = 0;
+      _bucketElapsed = 0;
+    }
+  }
+}
+
+/**
+* Returns a short name for a watering reason.
+*
+* @param reason The watering reason.
+* @return A constant string describing the reason.
+*/
+const char* wateringReasonName(WateringReasonEnum reason) {
+  switch (reason) {
+    case REASON_MANUAL:
+      return "manual";
+    case REASON_DRY:
+      return "dry";
+    case REASON_WET:
+      return "wet";
+    case REASON_CYCLE_END:
+      return "cycle_end";
+    case REASON_CYCLE_RESUME:
+      return "cycle_resume";
+    case REASON_DAILY_CAP:
+      return "daily_cap";
+    case REASON_DISABLED:
+      return "disabled";
+  }
+
+  return "unknown";
+}
@@ -0,0 +1,246 @@
+/**
+* WateringController.h
+* Declaration of the closed-loop watering controller.
+*
+* This file contains the declaration for the WateringController class, which decides when the
+* solenoid valve should open or close based on the filtered soil moisture signal. The controller
+* uses hysteresis thresholds, cycle and soak timing and a daily volume cap, and keeps working
+* without any broker connection. Manual commands from the broker are applied through the same
+* controller so that there is a single owner of the valve.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef WATERING_CONTROLLER_H
+#define WATERING_CONTROLLER_H
+
+#include "Arduino.h"
+
+// Length of the rolling window used for the daily volume cap, tracked in one-hour buckets.
+#define WATERING_DAY_MS 86400000UL
+#define WATERING_USAGE_BUCKETS 24
+#define WATERING_BUCKET_MS (WATERING_DAY_MS / WATERING_USAGE_BUCKETS)
+
+// Enum to represent the valve action taken by the controller.
+enum WateringActionEnum : byte {
+  VALVE_CLOSE,  // Valve has been closed.
+  VALVE_OPEN    // Valve has been opened.
+};
+
+// Enum to represent why the controller changed the valve state.
+enum WateringReasonEnum : byte {
+  REASON_MANUAL,        // Broker command.
+  REASON_DRY,           // Filtered moisture dropped below the dry threshold.
+  REASON_WET,           // Filtered moisture rose above the wet threshold.
+  REASON_CYCLE_END,     // Maximum run time of one cycle reached, soaking.
+  REASON_CYCLE_RESUME,  // Soak time elapsed and soil is still not wet.
+  REASON_DAILY_CAP,     // Daily volume cap reached.
+  REASON_DISABLED       // Automatic control was disabled while watering.
+};
+
+// Struct to hold the controller parameters.
+struct WateringParams {
+  bool enabled;              // Enable automatic watering.
+  uint16_t dryThreshold;     // Start watering below this moisture (0-1000 permille).
+  uint16_t wetThreshold;     // Stop watering above this moisture (0-1000 permille).
+  uint32_t maxRunSeconds;    // Longest single valve-open cycle.
+  uint32_t soakSeconds;      // Pause between cycles so water can soak in.
+  uint32_t flowRate;         // Valve flow rate in milliliters per minute.
+  uint32_t dailyCap;         // Maximum volume per rolling 24 h in milliliters.
+  uint16_t sensorDryRaw;     // Raw ADC reading of the sensor in dry air.
+  uint16_t sensorWetRaw;     // Raw ADC reading of the sensor in water.
+  uint8_t filterShift;       // Moisture filter strength, alpha = 1 / 2^filterShift.
+};
+
+// Struct to hold a single controller decision reported upstream.
+struct WateringEvent {
+  WateringActionEnum action;  // Valve action.
+  WateringReasonEnum reason;  // Reason for the action.
+  uint16_t moisture;          // Filtered moisture at the time of the decision (permille).
+  uint32_t durationMs;        // Valve-open duration of the finished run, zero when opening.
+  uint32_t volumeToday;       // Volume delivered in the current day window in milliliters.
+};
+
+// Struct to hold the valve-open time of the rolling day window, kept across restarts.
+struct WateringUsage {
+  uint32_t magic;                           // Marks a stored window, see usage().
+  uint32_t bucketElapsedMs;                 // Time spent in the current bucket.
+  uint32_t openMs[WATERING_USAGE_BUCKETS];  // Valve-open time per bucket.
+  uint8_t bucket;                           // Index of the current bucket.
+  uint32_t checksum;                        // Guards copies kept in memory that survives a reset.
+};
+
+class WateringController {
+public:
+  /**
+  * Constructs a WateringController object with default parameters.
+  * Automatic control is disabled until parameters are loaded or pushed by the broker.
+  */
+  WateringController();
+
+  /**
+  * Loads the controller parameters from preferences.
+  * Missing keys fall back to the default parameters.
+  */
+  void loadParams();
+
+  /**
+  * Stores the current controller parameters to preferences.
+  */
+  void saveParams();
+
+  /**
+  * Returns a snapshot of the day window, to be kept across restarts.
+  *
+  * @return The day window with its magic and checksum set.
+  */
+  WateringUsage usage() const;
+
+  /**
+  * Restores the day window saved before a restart.
+  * The time the device was off is unknown, so the window continues where it stopped. That keeps
+  * the cap in force through reboot loops at the cost of counting old runs slightly longer.
+  *
+  * @param usage A snapshot returned by usage().
+  * @return true if the snapshot was valid and restored; false otherwise.
+  */
+  bool restoreUsage(const WateringUsage& usage);
+
+  /**
+  * Restores the day window from preferences, if one was stored.
+  *
+  * @return true if a stored window was restored; false otherwise.
+  */
+  bool loadUsage();
+
+  /**
+  * Stores the day window to preferences. Call at the end of a run, not on every tick.
+  */
+  void saveUsage();
+
+  /**
+  * Replaces the controller parameters.
+  * Thresholds are sanitized so that the wet threshold is always above the dry threshold.
+  *
+  * @param params The new controller parameters.
+  */
+  void setParams(const WateringParams& params);
+
+  /**
+  * Returns the current controller parameters.
+  *
+  * @return Reference to the current controller parameters.
+  */
+  const WateringParams& params() const;
+
+  /**
+  * Feeds a raw ADC sample into the moisture filter.
+  * The sample is mapped to permille using the sensor calibration and smoothed with an exponential moving average.
+  *
+  * @param raw The raw ADC reading of the moisture sensor.
+  * @return The filtered moisture in permille (0 = dry, 1000 = wet).
+  */
+  uint16_t sampleMoisture(uint16_t raw);
+
+  /**
+  * Returns the last filtered moisture value.
+  *
+  * @return The filtered moisture in permille.
+  */
+  uint16_t moisture() const;
+
+  /**
+  * Requests a manual valve state from the broker.
+  * The request is applied on the next call to update().
+  *
+  * @param open True to open the valve, false to close it.
+  */
+  void requestManual(bool open);
+
+  /**
+  * Runs the control state machine.
+  * This function must be called periodically from a single task that owns the valve.
+  *
+  * @param now Current time in milliseconds.
+  * @param event Filled with the decision if the valve state changed.
+  * @return true if the valve state changed; false otherwise.
+  */
+  bool update(uint32_t now, WateringEvent& event);
+
+  /**
+  * Returns whether the controller wants the valve to be open.
+  *
+  * @return true if the valve should be open; false otherwise.
+  */
+  bool isValveOpen() const;
+
+  /**
+  * Returns the time of the last valve state change.
+  *
+  * @return Time in milliseconds, as passed to update().
+  */
+  uint32_t lastValveChange() const;
+
+  /**
+  * Returns the volume delivered in the current day window.
+  *
+  * @return Volume in milliliters.
+  */
+  uint32_t volumeToday() const;
+
+private:
+  // Enum to represent the internal state of the automatic control.
+  enum StateEnum : byte {
+    IDLE,      // Valve closed, waiting for dry soil.
+    WATERING,  // Valve open.
+    SOAKING    // Valve closed between cycles.
+  };
+
+  void openValve(uint32_t now, WateringReasonEnum reason, WateringEvent& event);
+  void closeValve(uint32_t now, WateringReasonEnum reason, StateEnum nextState, WateringEvent& event);
+  void accumulate(uint32_t now);
+
+  WateringParams _params;
+  StateEnum _state;
+  bool _valveOpen;
+  bool _manualActive;
+  volatile bool _manualPending;
+  volatile bool _manualOpen;
+  bool _hasSample;
+  int32_t _filtered;      // Filtered moisture, permille scaled by 16.
+  uint32_t _runStart;     // Time the valve opened.
+  uint32_t _soakStart;    // Time the soak pause started.
+  uint32_t _lastChange;   // Time of the last valve state change.
+  uint32_t _lastAccount;  // Time of the last volume accounting.
+  uint32_t _bucketElapsed;                   // Time spent in the current bucket.
+  uint32_t _openMs[WATERING_USAGE_BUCKETS];  // Valve-open time per hour of the day window.
+  uint8_t _bucket;                           // Index of the current bucket.
+};
+
+/**
+* Returns a short name for a watering reason.
+*
+* @param reason The watering reason.
+* @return A constant string describing the reason.
+*/
+const char* wateringReasonName(WateringReasonEnum reason);
+
+#endif
@@ -0,0 +1,448 @@
+/**
+* WateringHistory.cpp
+* Implementation of the persistent watering history log.
+*
+* This file contains the implementation for the WateringHistory class. Each segment file starts
+* with an 8 byte header (magic, sequence number) followed by fixed-size records in time order.
+* A cursor encodes the segment sequence number and the record position within that segment.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+#include "WateringHistory.h"
+#include <LittleFS.h>
+
+// Segment file header layout.
+#define HISTORY_MAGIC 0x53574831UL  // "SWH1"
+#define HISTORY_HEADER_SIZE 8
+
+/**
+* Constructs an empty WateringHistory object.
+* Call begin() after LittleFS is mounted to load the segment index.
+*/
+WateringHistory::WateringHistory()
+  : _pendingCount(0),
+    _lock(NULL),
+    _ready(false),
+    _suspended(false) {
+  memset(_segments, 0, sizeof(_segments));
+}
+
+/**
+* Creates the history directory if needed and builds the in-memory time index.
+* Only the header, first and last record of each segment are read.
+*
+* @return true if the history is ready; false otherwise.
+*/
+bool WateringHistory::begin() {
+  if (_lock == NULL) {
+    _lock = xSemaphoreCreateMutex();
+  }
+
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  bool ready = load();
+  xSemaphoreGive(_lock);
+
+  return ready;
+}
+
+/**
+* Stops using the file system, for example while its partition is rewritten.
+* Appends fail and queries return nothing until resume(); runs passed to appendRun() are held.
+*/
+void WateringHistory::suspend() {
+  if (_lock == NULL) {
+    return;
+  }
+
+  // Wait for a running append or query to finish before the caller unmounts the file system.
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  _suspended = true;
+  xSemaphoreGive(_lock);
+}
+
+/**
+* Rebuilds the time index after the file system has been mounted again.
+*
+* @return true if the history is ready; false otherwise.
+*/
+bool WateringHistory::resume() {
+  if (_lock == NULL) {
+    return false;
+  }
+
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  bool ready = load();
+  _suspended = false;
+  xSemaphoreGive(_lock);
+
+  return ready;
+}
+
+bool WateringHistory::load() {
+  _ready = false;
+
+  if (!LittleFS.exists("/history") && !LittleFS.mkdir("/history")) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < HISTORY_SEGMENT_COUNT; i++) {
+    Segment& segment = _segments[i];
+    memset(&segment, 0, sizeof(segment));
+
+    char path[32];
+    segmentPath(i, path, sizeof(path));
+
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+      continue;
+    }
+
+    uint32_t header[2] = { 0, 0 };
+    size_t size = file.size();
+    bool valid = size >= HISTORY_HEADER_SIZE && file.read((uint8_t*)header, sizeof(header)) == sizeof(header) && header[0] == HISTORY_MAGIC;
+    file.close();
+
+    // Unknown or damaged segments are treated as unused and recycled first.
+    if (!valid) {
+      continue;
+    }
+
+    segment.seq = header[1];
+    segment.count = min<size_t>((size - HISTORY_HEADER_SIZE) / sizeof(WateringRecord), HISTORY_SEGMENT_RECORDS);
+
+    WateringRecord record;
+    if (segment.count > 0 && readRecord(i, 0, record)) {
+      segment.first = record.start;
+    }
+    if (segment.count > 0 && readRecord(i, segment.count - 1, record)) {
+      segment.last = record.start;
+    }
+  }
+
+  _ready = true;
+  return true;
+}
+
+/**
+* Appends a watering run to the log.
+* When the active segment is full, the oldest segment is recycled.
+* Start times are clamped to be non-decreasing so the index stays sorted.
+*
+* @param record The watering run to store.
+* @return true if the record was written; false otherwise.
+*/
+bool WateringHistory::append(const WateringRecord& record) {
+  if (_lock == NULL) {
+    return false;
+  }
+
+  xSemaphoreTake(_lock, portMAX_DELAY);
+
+  if (!_ready || _suspended) {
+    xSemaphoreGive(_lock);
+    return false;
+  }
+
+  int8_t active = activeSegment();
+  char path[32];
+
+  if (active < 0 || _segments[active].count >= HISTORY_SEGMENT_RECORDS) {
+    uint32_t seq = active < 0 ? 1 : _segments[active].seq + 1;
+
+    // Recycle an unused segment or the one holding the oldest records.
+    uint8_t victim = 0;
+    for (uint8_t i = 1; i < HISTORY_SEGMENT_COUNT; i++) {
+      if (_segments[i].seq < _segments[victim].seq) {
+        victim = i;
+      }
+    }
+
+    segmentPath(victim, path, sizeof(path));
+    File file = LittleFS.open(path, "w");
+    uint32_t header[2] = { HISTORY_MAGIC, seq };
+
+    if (!file || file.write((const uint8_t*)header, sizeof(header)) != sizeof(header)) {
+      xSemaphoreGive(_lock);
+      return false;
+    }
+    file.close();
+
+    _segments[victim].seq = seq;
+    _segments[victim].count = 0;
+    _segments[victim].first = 0;
+    _segments[victim].last = 0;
+    active = victim;
+  }
+
+  Segment& segment = _segments[active];
+  WateringRecord stored = record;
+
+  // Keep records sorted even if the clock stepped backwards.
+  for (uint8_t i = 0; i < HISTORY_SEGMENT_COUNT; i++) {
+    if (_segments[i].seq != 0 && _segments[i].count > 0) {
+      stored.start = max(stored.start, _segments[i].last);
+    }
+  }
+
+  segmentPath(active, path, sizeof(path));
+  File file = LittleFS.open(path, "a");
+  bool written = file && file.write((const uint8_t*)&stored, sizeof(stored)) == sizeof(stored);
+  file.close();
+
+  if (written) {
+    if (segment.count == 0) {
+      segment.first = stored.start;
+    }
+    segment.last = stored.start;
+    segment.count++;
+  }
+
+  xSemaphoreGive(_lock);
+  return written;
+}
+
+/**
+* Records a finished watering run that has just ended.
+* When the clock is not set yet, the run is held in memory with its uptime and stored by
+* flushPending() once the clock is known, so no record ever gets a 1970 start time.
+* Only call this and flushPending() from one task.
+*
+* @param duration Run duration in seconds.
+* @param zone Valve zone.
+* @param trigger WateringReasonEnum that opened the valve.
+* @return true if the run was stored or held; false otherwise.
+*/
+bool WateringHistory::appendRun(uint16_t duration, uint8_t zone, uint8_t trigger) {
+  WateringRecord record;
+  record.duration = duration;
+  record.zone = zone;
+  record.trigger = trigger;
+
+  time_t now = time(nullptr);
+  if (now >= (time_t)HISTORY_MIN_EPOCH && !_suspended) {
+    // Keep the log in order if runs from before the clock was set are still waiting.
+    flushPending();
+    record.start = now - duration;
+    return append(record);
+  }
+
+  // Drop the oldest held run if the clock stays unset or the history is suspended for long.
+  if (_pendingCount >= HISTORY_PENDING_RECORDS) {
+    memmove(&_pending[0], &_pending[1], (HISTORY_PENDING_RECORDS - 1) * sizeof(WateringRecord));
+    _pendingCount--;
+  }
+
+  uint32_t uptime = millis() / 1000;
+  record.start = uptime > duration ? uptime - duration : 0;
+  _pending[_pendingCount++] = record;
+  return true;
+}
+
+/**
+* Stores the runs held since boot once the clock is set.
+* Their start times are rebuilt from the uptime at which they started.
+*/
+void WateringHistory::flushPending() {
+  if (_pendingCount == 0 || !_ready || _suspended) {
+    return;
+  }
+
+  time_t now = time(nullptr);
+  if (now < (time_t)HISTORY_MIN_EPOCH) {
+    return;
+  }
+
+  uint32_t uptime = millis() / 1000;
+  for (uint8_t i = 0; i < _pendingCount; i++) {
+    WateringRecord record = _pending[i];
+    record.start = now - (uptime - record.start);
+    append(record);
+  }
+
+  _pendingCount = 0;
+}
+
+/**
+* Reads a page of records starting at a time or a cursor.
+*
+* @param since Return records with a start time at or after this value when cursor is zero.
+* @param cursor Position to resume from, or zero to start at since. Updated to the next position or HISTORY_END.
+* @param records Output buffer for the records.
+* @param maxRecords Capacity of the output buffer.
+* @return Number of records written to the output buffer.
+*/
+size_t WateringHistory::query(uint32_t since, uint32_t& cursor, WateringRecord* records, size_t maxRecords) {
+  if (_lock == NULL || cursor == HISTORY_END) {
+    cursor = HISTORY_END;
+    return 0;
+  }
+
+  xSemaphoreTake(_lock, portMAX_DELAY);
+
+  if (!_ready || _suspended) {
+    xSemaphoreGive(_lock);
+    cursor = HISTORY_END;
+    return 0;
+  }
+
+  uint32_t position = cursor == 0 ? locate(since) : cursor;
+  uint32_t seq = position / HISTORY_SEGMENT_RECORDS;
+  uint16_t offset = position % HISTORY_SEGMENT_RECORDS;
+  size_t found = 0;
+
+  // Resume from the oldest remaining segment if the cursor's segment has been recycled.
+  int8_t index = -1;
+  for (uint8_t i = 0; i < HISTORY_SEGMENT_COUNT; i++) {
+    if (_segments[i].seq == seq && seq != 0) {
+      index = i;
+    }
+  }
+  if (index < 0 && position != HISTORY_END) {
+    index = nextSegment(seq);
+    offset = 0;
+  }
+
+  cursor = HISTORY_END;
+
+  while (index >= 0 && position != HISTORY_END) {
+    Segment& segment = _segments[index];
+    uint16_t available = segment.count > offset ? segment.count - offset : 0;
+    uint16_t batch = min<size_t>(available, maxRecords - found);
+
+    if (batch > 0) {
+      char path[32];
+      segmentPath(index, path, sizeof(path));
+
+      File file = LittleFS.open(path, "r");
+      if (file && file.seek(HISTORY_HEADER_SIZE + offset * sizeof(WateringRecord))) {
+        found += file.read((uint8_t*)&records[found], batch * sizeof(WateringRecord)) / sizeof(WateringRecord);
+      }
+      file.close();
+    }
+
+    if (found >= maxRecords) {
+      // More records may follow in this or a newer segment.
+      if (offset + batch < segment.count) {
+        cursor = segment.seq * HISTORY_SEGMENT_RECORDS + offset + batch;
+      } else if (nextSegment(segment.seq) >= 0) {
+        cursor = (segment.seq + 1) * HISTORY_SEGMENT_RECORDS;
+      }
+      break;
+    }
+
+    index = nextSegment(segment.seq);
+    offset = 0;
+  }
+
+  xSemaphoreGive(_lock);
+  return found;
+}
+
+/**
+* Returns the number of records currently stored.
+*
+* @return Total number of records in all segments.
+*/
+uint32_t WateringHistory::count() {
+  uint32_t total = 0;
+
+  for (uint8_t i = 0; i < HISTORY_SEGMENT_COUNT; i++) {
+    total += _segments[i].seq != 0 ? _segments[i].count : 0;
+  }
+
+  return total;
+}
+
+void WateringHistory::segmentPath(uint8_t index, char* path, size_t size) {
+  snprintf(path, size, "/history/seg%u.bin", index);
+}
+
+int8_t WateringHistory::activeSegment() {
+  int8_t active = -1;
+
+  for (uint8_t i = 0; i < HISTORY_SEGMENT_COUNT; i++) {
+    if (_segments[i].seq != 0 && (active < 0 || _segments[i].seq > _segments[active].seq)) {
+      active = i;
+    }
+  }
+
+  return active;
+}
+
+int8_t WateringHistory::nextSegment(uint32_t afterSeq) {
+  int8_t next = -1;
+
+  for (uint8_t i = 0; i < HISTORY_SEGMENT_COUNT; i++) {
+    if (_segments[i].seq > afterSeq && (next < 0 || _segments[i].seq < _segments[next].seq)) {
+      next = i;
+    }
+  }
+
+  return next;
+}
+
+bool WateringHistory::readRecord(uint8_t index, uint16_t position, WateringRecord& record) {
+  char path[32];
+  segmentPath(index, path, sizeof(path));
+
+  File file = LittleFS.open(path, "r");
+  bool read = file && file.seek(HISTORY_HEADER_SIZE + position * sizeof(WateringRecord)) && file.read((uint8_t*)&record, sizeof(record)) == sizeof(record);
+  file.close();
+
+  return read;
+}
+
+uint16_t WateringHistory::lowerBound(uint8_t index, uint32_t since) {
+  uint16_t low = 0;
+  uint16_t high = _segments[index].count;
+
+  // Binary search for the first record at or after since.
+  while (low < high) {
+    uint16_t middle = low + (high - low) / 2;
+    WateringRecord record;
+
+    if (readRecord(index, middle, record) && record.start < since) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+uint32_t WateringHistory::locate(uint32_t since) {
+  // Walk the time index in ring order and only touch the segment that contains since.
+  for (int8_t index = nextSegment(0); index >= 0; index = nextSegment(_segments[index].seq)) {
+    const Segment& segment = _segments[index];
+
+    if (segment.count == 0 || segment.last < since) {
+      continue;
+    }
+
+    uint16_t position = segment.first >= since ? 0 : lowerBound(index, since);
+    return segment.seq * HISTORY_SEGMENT_RECORDS + position;
+  }
+
+  return HISTORY_END;
+}
@@ -0,0 +1,156 @@
+/**
+* WateringHistory.h
+* Declaration of the persistent watering history log.
+*
+* This file contains the declaration for the WateringHistory class, which stores one compact record
+* per watering run on LittleFS. Records are appended to a fixed ring of segment files so the log
+* never grows beyond its budget, and a small in-memory time index over the segments keeps range
+* queries fast regardless of how much history is stored.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef WATERING_HISTORY_H
+#define WATERING_HISTORY_H
+
+#include "Arduino.h"
+
+// Define the history ring geometry.
+#define HISTORY_SEGMENT_COUNT 8     // Number of segment files in the ring.
+#define HISTORY_SEGMENT_RECORDS 512  // Records per segment, one 4 KB flash block of payload.
+
+// Runs that end before the clock is set are held in memory until it is.
+#define HISTORY_PENDING_RECORDS 8
+#define HISTORY_MIN_EPOCH 1704067200UL  // 2024-01-01, anything earlier means the clock is not set.
+
+// Cursor value returned when a query has no more records.
+#define HISTORY_END 0xFFFFFFFFUL
+
+// Struct to hold a single watering run.
+struct __attribute__((packed)) WateringRecord {
+  uint32_t start;     // Run start time in seconds since the Unix epoch.
+  uint16_t duration;  // Run duration in seconds.
+  uint8_t zone;       // Valve zone.
+  uint8_t trigger;    // WateringReasonEnum that opened the valve.
+};
+
+class WateringHistory {
+public:
+  /**
+  * Constructs an empty WateringHistory object.
+  * Call begin() after LittleFS is mounted to load the segment index.
+  */
+  WateringHistory();
+
+  /**
+  * Creates the history directory if needed and builds the in-memory time index.
+  * Only the header, first and last record of each segment are read.
+  *
+  * @return true if the history is ready; false otherwise.
+  */
+  bool begin();
+
+  /**
+  * Stops using the file system, for example while its partition is rewritten.
+  * Appends fail and queries return nothing until resume(); runs passed to appendRun() are held.
+  */
+  void suspend();
+
+  /**
+  * Rebuilds the time index after the file system has been mounted again.
+  *
+  * @return true if the history is ready; false otherwise.
+  */
+  bool resume();
+
+  /**
+  * Appends a watering run to the log.
+  * When the active segment is full, the oldest segment is recycled.
+  * Start times are clamped to be non-decreasing so the index stays sorted.
+  *
+  * @param record The watering run to store.
+  * @return true if the record was written; false otherwise.
+  */
+  bool append(const WateringRecord& record);
+
+  /**
+  * Records a finished watering run that has just ended.
+  * When the clock is not set yet, the run is held in memory with its uptime and stored by
+  * flushPending() once the clock is known, so no record ever gets a 1970 start time.
+  * Only call this and flushPending() from one task.
+  *
+  * @param duration Run duration in seconds.
+  * @param zone Valve zone.
+  * @param trigger WateringReasonEnum that opened the valve.
+  * @return true if the run was stored or held; false otherwise.
+  */
+  bool appendRun(uint16_t duration, uint8_t zone, uint8_t trigger);
+
+  /**
+  * Stores the runs held since boot once the clock is set.
+  * Their start times are rebuilt from the uptime at which they started.
+  */
+  void flushPending();
+
+  /**
+  * Reads a page of records starting at a time or a cursor.
+  *
+  * @param since Return records with a start time at or after this value when cursor is zero.
+  * @param cursor Position to resume from, or zero to start at since. Updated to the next position or HISTORY_END.
+  * @param records Output buffer for the records.
+  * @param maxRecords Capacity of the output buffer.
+  * @return Number of records written to the output buffer.
+  */
+  size_t query(uint32_t since, uint32_t& cursor, WateringRecord* records, size_t maxRecords);
+
+  /**
+  * Returns the number of records currently stored.
+  *
+  * @return Total number of records in all segments.
+  */
+  uint32_t count();
+
+private:
+  // Struct to hold the time index entry of one segment.
+  struct Segment {
+    uint32_t seq;    // Ring sequence number, zero if unused.
+    uint16_t count;  // Number of records in the segment.
+    uint32_t first;  // Start time of the first record.
+    uint32_t last;   // Start time of the last record.
+  };
+
+  bool load();
+  void segmentPath(uint8_t index, char* path, size_t size);
+  int8_t activeSegment();
+  int8_t nextSegment(uint32_t afterSeq);
+  bool readRecord(uint8_t index, uint16_t position, WateringRecord& record);
+  uint16_t lowerBound(uint8_t index, uint32_t since);
+  uint32_t locate(uint32_t since);
+
+  Segment _segments[HISTORY_SEGMENT_COUNT];
+  WateringRecord _pending[HISTORY_PENDING_RECORDS];  // Start holds seconds of uptime.
+  uint8_t _pendingCount;
+  SemaphoreHandle_t _lock;
+  bool _ready;
+  volatile bool _suspended;
+};
+
+#endif
@@ -4,11 +4,40 @@
 #include <LittleFS.h>
 #include <Preferences.h>
 #include <ArduinoJson.h>
+#include "Payload.h"
 
 AsyncWebServer server(80);
 AsyncWebSocket ws("/ws");
 Preferences prefs;
 
+// Returns the first text field of a save request that exceeds its limit in WiFiConfig.h, or NULL
+static const char* findOverlongField(JsonDocument &doc) {
+    static const struct {
+        const char *key;
+        size_t limit;
+    } fields[] = {
+        { "ssidName", CONFIG_SSID_LENGTH },
+        { "ssidPassword", CONFIG_PASSWORD_LENGTH },
+        { "mqttServer", CONFIG_SERVER_LENGTH },
+        { "mqttCaCert", CONFIG_CA_CERT_LENGTH },
+        { "mqttFingerprint", CONFIG_FINGERPRINT_LENGTH },
+        { "mqttUsername", CONFIG_CREDENTIAL_LENGTH },
+        { "mqttPassword", CONFIG_CREDENTIAL_LENGTH },
+        { "mqttClientId", CONFIG_CLIENT_ID_LENGTH },
+        { "mqttTopic", CONFIG_TOPIC_LENGTH },
+        { "localToken", CONFIG_LOCAL_TOKEN_LENGTH },
+    };
+
+    for (const auto &field : fields) {
+        const char *value = doc[field.key] | "";
+        if (strlen(value) > field.limit) {
+            return field.key;
+        }
+    }
+
+    return NULL;
+}
+
 void handleWebSocketMessage(AsyncWebSocketClient *client, String data) {
   JsonDocument doc;
   DeserializationError err = deserializeJson(doc, data);
@@ -18,20 +47,7 @@ void handleWebSocketMessage(AsyncWebSocketClient *client, String data) {
 
   if (action == "get_config") {
     JsonDocument response;
-    response["action"] = "config_data";
-
-    prefs.begin("wifi_config", true);
-    response["ssidName"] = prefs.getString("ssidName", "");
-    response["ssidPassword"] = prefs.getString("ssidPassword", "");
-    response["mqttServer"] = prefs.getString("mqttServer", "");
-    response["mqttServerPort"] = prefs.getInt("mqttServerPort", 1883);
-    response["mqttUsername"] = prefs.getString("mqttUsername", "");
-    response["mqttPassword"] = prefs.getString("mqttPassword", "");
-    response["mqttClientId"] = prefs.getString("mqttClientId", "");
-    response["mqttTopic"] = prefs.getString("mqttTopic", "");
-    response["rgb"] = prefs.getBool("rgb", true);
-    response["buzzer"] = prefs.getBool("buzzer", true);
-    prefs.end();
+    constructConfigPayload(response, prefs);
 
     String json;
     serializeJson(response, json);
@@ -39,16 +55,37 @@ void handleWebSocketMessage(AsyncWebSocketClient *client, String data) {
   }
 
   else if (action == "save_config") {
+    // Refuse the whole save rather than store a value the device would not load.
+    const char *overlong = findOverlongField(doc);
+    if (overlong != NULL) {
+      JsonDocument response;
+      response["action"] = "save_ack";
+      response["status"] = "too_long";
+      response["field"] = overlong;
+
+      String json;
+      serializeJson(response, json);
+      client->text(json);
+      return;
+    }
+
     prefs.begin("wifi_config", false);
 
     prefs.putString("ssidName", doc["ssidName"] | "");
     prefs.putString("ssidPassword", doc["ssidPassword"] | "");
     prefs.putString("mqttServer", doc["mqttServer"] | "");
     prefs.putInt("mqttServerPort", doc["mqttServerPort"] | 1883);
+    prefs.putBool("mqttTls", doc["mqttTls"]);
+    prefs.putString("mqttCaCert", doc["mqttCaCert"] | "");
+    prefs.putString("mqttFingerprint", doc["mqttFingerprint"] | "");
     prefs.putString("mqttUsername", doc["mqttUsername"] | "");
     prefs.putString("mqttPassword", doc["mqttPassword"] | "");
     prefs.putString("mqttClientId", doc["mqttClientId"] | "");
     prefs.putString("mqttTopic", doc["mqttTopic"] | "");
+    prefs.putInt("mqttKeepAlive", doc["mqttKeepAlive"] | 30);
+    prefs.putInt("heartbeat", doc["heartbeatInterval"] | 300);
+    prefs.putInt("encoding", doc["payloadEncoding"] | 0);
+    prefs.putString("localToken", doc["localToken"] | "");
     prefs.putBool("rgb", doc["rgb"]);
     prefs.putBool("buzzer", doc["buzzer"]);
     prefs.end();
@@ -122,22 +159,41 @@ void clearWiFiConfig() {
     prefs.end();
 }
 
-WiFiConfig loadWiFiConfig() {
+// Copies a stored string into a fixed-capacity field, a value that does not fit leaves the field empty
+template <size_t Capacity>
+static bool loadString(Preferences& prefs, const char* key, FixedString<Capacity>& value) {
+    if (value.assign(prefs.getString(key, "").c_str())) {
+        return true;
+    }
+
+    Serial.printf("Stored value of '%s' exceeds %u characters\n", key, (unsigned int)Capacity);
+    value.clear();
+    return false;
+}
+
+bool loadWiFiConfig(WiFiConfig& config) {
     Preferences prefs;
-    WiFiConfig config;
+    bool valid = true;
 
     prefs.begin("wifi_config", true); // read-only
-    config.ssidName = prefs.getString("ssidName", "");
-    config.ssidPassword = prefs.getString("ssidPassword", "");
-    config.mqttServer = prefs.getString("mqttServer", "");
+    valid &= loadString(prefs, "ssidName", config.ssidName);
+    valid &= loadString(prefs, "ssidPassword", config.ssidPassword);
+    valid &= loadString(prefs, "mqttServer", config.mqttServer);
     config.mqttServerPort = prefs.getInt("mqttServerPort", 1883);
-    config.mqttUsername = prefs.getString("mqttUsername", "");
-    config.mqttPassword = prefs.getString("mqttPassword", "");
-    config.mqttClientId = prefs.getString("mqttClientId", "");
-    config.mqttTopic = prefs.getString("mqttTopic", "");
+    config.mqttTls = prefs.getBool("mqttTls", false);
+    valid &= loadString(prefs, "mqttCaCert", config.mqttCaCert);
+    valid &= loadString(prefs, "mqttFingerprint", config.mqttFingerprint);
+    valid &= loadString(prefs, "mqttUsername", config.mqttUsername);
+    valid &= loadString(prefs, "mqttPassword", config.mqttPassword);
+    valid &= loadString(prefs, "mqttClientId", config.mqttClientId);
+    valid &= loadString(prefs, "mqttTopic", config.mqttTopic);
+    config.mqttKeepAlive = prefs.getInt("mqttKeepAlive", 30);
+    config.heartbeatInterval = prefs.getInt("heartbeat", 300);
+    config.payloadEncoding = prefs.getInt("encoding", 0);
+    valid &= loadString(prefs, "localToken", config.localToken);
     config.rgb = prefs.getBool("rgb", true);
     config.buzzer = prefs.getBool("buzzer", true);
     prefs.end();
 
-    return config;
+    return valid;
 }
\ No newline at end of file
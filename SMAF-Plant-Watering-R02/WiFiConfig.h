@@ -2,17 +2,39 @@
 #define WIFI_CONFIG_H
 
 #include <Arduino.h>
+#include "FixedString.h"
+
+// Maximum field lengths, excluding the terminator. Keep in sync with maxlength in data/index.html.
+#define CONFIG_SSID_LENGTH 32           // 802.11 SSID limit.
+#define CONFIG_PASSWORD_LENGTH 64       // WPA2 passphrase (63) or raw hex key (64).
+#define CONFIG_SERVER_LENGTH 64         // Broker host name or address.
+#define CONFIG_CREDENTIAL_LENGTH 64     // MQTT username and password.
+#define CONFIG_CLIENT_ID_LENGTH 32      // MQTT client identifier.
+#define CONFIG_TOPIC_LENGTH 64          // MQTT base topic.
+#define CONFIG_FINGERPRINT_LENGTH 95    // SHA-256 as colon separated hex.
+#define CONFIG_CA_CERT_LENGTH 3999      // PEM CA certificate or chain, NVS strings hold at most 4000 bytes with the terminator.
+#define CONFIG_LOCAL_TOKEN_LENGTH 32    // Local control token, empty disables the local endpoint.
+
+// Longest suffix appended to the base topic ("/history/get").
+#define CONFIG_TOPIC_SUFFIX_LENGTH 12
 
 // Struct to hold the WiFi and MQTT configuration
 struct WiFiConfig {
-    String ssidName;
-    String ssidPassword;
-    String mqttServer;
+    FixedString<CONFIG_SSID_LENGTH> ssidName;
+    FixedString<CONFIG_PASSWORD_LENGTH> ssidPassword;
+    FixedString<CONFIG_SERVER_LENGTH> mqttServer;
     int mqttServerPort;
-    String mqttUsername;
-    String mqttPassword;
-    String mqttClientId;
-    String mqttTopic;
+    bool mqttTls;
+    FixedString<CONFIG_CA_CERT_LENGTH> mqttCaCert;
+    FixedString<CONFIG_FINGERPRINT_LENGTH> mqttFingerprint;
+    FixedString<CONFIG_CREDENTIAL_LENGTH> mqttUsername;
+    FixedString<CONFIG_CREDENTIAL_LENGTH> mqttPassword;
+    FixedString<CONFIG_CLIENT_ID_LENGTH> mqttClientId;
+    FixedString<CONFIG_TOPIC_LENGTH> mqttTopic;
+    int mqttKeepAlive;
+    int heartbeatInterval;
+    int payloadEncoding;  // 0 = JSON, 1 = MessagePack
+    FixedString<CONFIG_LOCAL_TOKEN_LENGTH> localToken;
     bool rgb;
     bool buzzer;
 };
@@ -21,7 +43,7 @@ struct WiFiConfig {
 void setupWiFiConfig();
 void clearWiFiConfig();
 
-// Loads the stored configuration into a struct
-WiFiConfig loadWiFiConfig();
+// Loads the stored configuration into a struct, returns false if a stored value exceeds its field length
+bool loadWiFiConfig(WiFiConfig& config);
 
 #endif // WIFI_CONFIG_H
\ No newline at end of file
@@ -19,6 +19,11 @@ window.addEventListener('load', () => {
         if (data.action === "wifi_list") {
             updateSSIDList(data.ssids, savedSSID);
             cancelScanState();
+        } else if (data.action === "save_ack" && data.status !== "ok") {
+            // The device refused the save, keep the form so the field can be fixed.
+            console.log(`Config not saved: ${data.field} is too long.`);
+            const field = document.getElementById(data.field);
+            if (field) field.focus();
         } else if (data.action === "save_ack") {
             console.log("Config saved. Restarting...");
     
@@ -69,10 +74,17 @@ function populateForm(data) {
     document.getElementById("ssidPassword").value = data.ssidPassword || "";
     document.getElementById("mqttServer").value = data.mqttServer || "";
     document.getElementById("mqttServerPort").value = data.mqttServerPort || 1883;
+    document.querySelector('input[name="mqttTls"]').checked = data.mqttTls || false;
+    document.getElementById("mqttCaCert").value = data.mqttCaCert || "";
+    document.getElementById("mqttFingerprint").value = data.mqttFingerprint || "";
     document.getElementById("mqttUsername").value = data.mqttUsername || "";
     document.getElementById("mqttPassword").value = data.mqttPassword || "";
     document.getElementById("mqttClientId").value = data.mqttClientId || "";
     document.getElementById("mqttTopic").value = data.mqttTopic || "";
+    document.getElementById("mqttKeepAlive").value = data.mqttKeepAlive || 30;
+    document.getElementById("heartbeatInterval").value = data.heartbeatInterval || 300;
+    document.getElementById("payloadEncoding").value = data.payloadEncoding || 0;
+    document.getElementById("localToken").value = data.localToken || "";
     document.querySelector('input[name="rgb"]').checked = data.rgb || false;
     document.querySelector('input[name="buzzer"]').checked = data.buzzer || false;
 
@@ -218,10 +230,17 @@ function onSubmit() {
         ssidPassword: document.getElementById("ssidPassword").value || "",
         mqttServer: document.getElementById("mqttServer").value || "",
         mqttServerPort: parseInt(document.getElementById("mqttServerPort").value) || 1883,
+        mqttTls: document.querySelector('input[name="mqttTls"]').checked,
+        mqttCaCert: document.getElementById("mqttCaCert").value.trim() || "",
+        mqttFingerprint: document.getElementById("mqttFingerprint").value.trim() || "",
         mqttUsername: document.getElementById("mqttUsername").value || "",
         mqttPassword: document.getElementById("mqttPassword").value || "",
         mqttClientId: document.getElementById("mqttClientId").value || "",
         mqttTopic: document.getElementById("mqttTopic").value || "",
+        mqttKeepAlive: parseInt(document.getElementById("mqttKeepAlive").value) || 30,
+        heartbeatInterval: parseInt(document.getElementById("heartbeatInterval").value) || 300,
+        payloadEncoding: parseInt(document.getElementById("payloadEncoding").value) || 0,
+        localToken: document.getElementById("localToken").value || "",
         rgb: document.querySelector('input[name="rgb"]').checked,
         buzzer: document.querySelector('input[name="buzzer"]').checked
     };
@@ -237,8 +256,11 @@ function validateForm() {
         { id: "mqttServerPort", required: true },
         { id: "mqttUsername", required: false },
         { id: "mqttPassword", required: false },
+        { id: "mqttFingerprint", required: false },
         { id: "mqttClientId", required: true },
-        { id: "mqttTopic", required: true }
+        { id: "mqttTopic", required: true },
+        { id: "mqttKeepAlive", required: true, numeric: true },
+        { id: "heartbeatInterval", required: true, numeric: true }
     ];
 
     let valid = true;
@@ -259,7 +281,15 @@ function validateForm() {
             errorMessage = "Can't be empty.";
         }
 
-        if (field.id === "mqttServerPort") {
+        // TLS needs either a pinned CA certificate or a server fingerprint.
+        if (field.id === "mqttFingerprint" && document.querySelector('input[name="mqttTls"]').checked) {
+            if (value === "" && document.getElementById("mqttCaCert").value.trim() === "") {
+                hasError = true;
+                errorMessage = "CA certificate or fingerprint required.";
+            }
+        }
+
+        if (field.id === "mqttServerPort" || field.numeric) {
             if (value === "") {
                 hasError = true;
                 errorMessage = "Can't be empty.";
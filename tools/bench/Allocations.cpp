@@ -0,0 +1,133 @@
+/**
+* Allocations.cpp
+* Implementation of the heap allocation counters of the benchmark suite.
+*
+* This file contains the allocator wrappers and the counters declared in Allocations.h.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Allocations.h"
+#include <cerrno>
+#include <malloc.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+// The benchmarks run on a single thread, so plain counters are sufficient.
+static uint64_t allocations = 0;
+static int64_t liveBytes = 0;
+static int64_t baseBytes = 0;
+static int64_t peakBytes = 0;
+
+static void track(void* ptr, int64_t sign) {
+  if (ptr == NULL) {
+    return;
+  }
+
+  liveBytes += sign * (int64_t)malloc_usable_size(ptr);
+  if (liveBytes > peakBytes) {
+    peakBytes = liveBytes;
+  }
+}
+
+/**
+* Restarts counting allocations and tracking the peak from the current live heap size.
+*/
+void resetAllocationStats() {
+  allocations = 0;
+  baseBytes = liveBytes;
+  peakBytes = liveBytes;
+}
+
+/**
+* Returns the heap counters since the last reset.
+*
+* @return The allocation count and peak heap size.
+*/
+AllocationStats allocationStats() {
+  return { allocations, (size_t)(peakBytes - baseBytes) };
+}
+
+extern "C" void* malloc(size_t size) {
+  void* ptr = __libc_malloc(size);
+  allocations += ptr != NULL;
+  track(ptr, 1);
+  return ptr;
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+  void* ptr = __libc_calloc(count, size);
+  allocations += ptr != NULL;
+  track(ptr, 1);
+  return ptr;
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+  size_t previous = ptr != NULL ? malloc_usable_size(ptr) : 0;
+
+  // A growing realloc counts as an allocation, a shrinking one does not.
+  if (ptr != NULL) {
+    track(ptr, -1);
+  }
+
+  void* result = __libc_realloc(ptr, size);
+
+  if (result != NULL) {
+    allocations += size > previous;
+    track(result, 1);
+  } else if (ptr != NULL && size != 0) {
+    track(ptr, 1);
+  }
+
+  return result;
+}
+
+extern "C" void* memalign(size_t alignment, size_t size) {
+  void* ptr = __libc_memalign(alignment, size);
+  allocations += ptr != NULL;
+  track(ptr, 1);
+  return ptr;
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size) {
+  return memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** result, size_t alignment, size_t size) {
+  void* ptr = memalign(alignment, size);
+  if (ptr == NULL) {
+    return ENOMEM;
+  }
+
+  *result = ptr;
+  return 0;
+}
+
+extern "C" void free(void* ptr) {
+  track(ptr, -1);
+  __libc_free(ptr);
+}
@@ -0,0 +1,54 @@
+/**
+* Allocations.h
+* Declaration of the heap allocation counters of the benchmark suite.
+*
+* The benchmark binary replaces malloc, calloc, realloc and free with wrappers around the glibc
+* allocator. The wrappers count allocations and track the live and peak heap size, so every code
+* path linked into the binary, including String and ArduinoJson, is measured without changes.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef ALLOCATIONS_H
+#define ALLOCATIONS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Struct to hold the heap counters since the last reset.
+struct AllocationStats {
+  uint64_t allocations;  // Successful malloc, calloc and growing realloc calls.
+  size_t peak;           // Highest live heap size above the size at reset, in bytes.
+};
+
+/**
+* Restarts counting allocations and tracking the peak from the current live heap size.
+*/
+void resetAllocationStats();
+
+/**
+* Returns the heap counters since the last reset.
+*
+* @return The allocation count and peak heap size.
+*/
+AllocationStats allocationStats();
+
+#endif
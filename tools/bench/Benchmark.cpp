@@ -0,0 +1,147 @@
+/**
+* Benchmark.cpp
+* Implementation of the benchmark baseline handling.
+*
+* This file contains the baseline file format and the regression check declared in Benchmark.h.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Benchmark.h"
+#include <cstdio>
+
+// Tolerance for the allocation count, which is averaged over the iterations.
+#define ALLOCATION_EPSILON 0.01
+
+static const BenchmarkResult* find(const std::vector<BenchmarkResult>& results, const std::string& name) {
+  for (const BenchmarkResult& result : results) {
+    if (result.name == name) {
+      return &result;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+* Loads a baseline file.
+* Every line holds the name, ns/op, allocations/op and peak heap of one benchmark.
+*
+* @param path Path of the baseline file.
+* @param results Results to fill.
+* @return false if the file cannot be read; true otherwise.
+*/
+bool loadBaseline(const char* path, std::vector<BenchmarkResult>& results) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    return false;
+  }
+
+  char name[64];
+  BenchmarkResult result;
+
+  while (fscanf(file, "%63s %lf %lf %zu", name, &result.nsPerOp, &result.allocsPerOp, &result.peakHeap) == 4) {
+    result.name = name;
+    results.push_back(result);
+  }
+
+  fclose(file);
+  return true;
+}
+
+/**
+* Saves results as the new baseline.
+*
+* @param path Path of the baseline file.
+* @param results Results to save.
+* @return false if the file cannot be written; true otherwise.
+*/
+bool saveBaseline(const char* path, const std::vector<BenchmarkResult>& results) {
+  FILE* file = fopen(path, "w");
+  if (file == NULL) {
+    return false;
+  }
+
+  for (const BenchmarkResult& result : results) {
+    fprintf(file, "%s %.1f %.2f %zu\n", result.name.c_str(), result.nsPerOp, result.allocsPerOp, result.peakHeap);
+  }
+
+  return fclose(file) == 0;
+}
+
+/**
+* Compares results against a baseline and prints every regression.
+* Time may grow by the given percentage before it counts as a regression. Allocations and peak heap
+* are deterministic, so any growth counts.
+*
+* @param results Results of this run.
+* @param baseline Results of the baseline.
+* @param thresholdPercent Allowed time growth in percent.
+* @return Number of regressions found.
+*/
+int compareBaseline(const std::vector<BenchmarkResult>& results, const std::vector<BenchmarkResult>& baseline, double thresholdPercent) {
+  int regressions = 0;
+
+  for (const BenchmarkResult& result : results) {
+    const BenchmarkResult* base = find(baseline, result.name);
+    if (base == NULL) {
+      continue;
+    }
+
+    if (result.nsPerOp > base->nsPerOp * (1.0 + thresholdPercent / 100.0)) {
+      printf("REGRESSION %s: %.1f ns/op, baseline %.1f ns/op (+%.0f %%, threshold %.0f %%)\n", result.name.c_str(), result.nsPerOp, base->nsPerOp, (result.nsPerOp / base->nsPerOp - 1.0) * 100.0, thresholdPercent);
+      regressions++;
+    }
+
+    if (result.allocsPerOp > base->allocsPerOp + ALLOCATION_EPSILON) {
+      printf("REGRESSION %s: %.2f allocs/op, baseline %.2f allocs/op\n", result.name.c_str(), result.allocsPerOp, base->allocsPerOp);
+      regressions++;
+    }
+
+    if (result.peakHeap > base->peakHeap) {
+      printf("REGRESSION %s: %zu B peak heap, baseline %zu B\n", result.name.c_str(), result.peakHeap, base->peakHeap);
+      regressions++;
+    }
+  }
+
+  return regressions;
+}
+
+/**
+* Prints results as a table, with the change against the baseline when one is given.
+*
+* @param results Results of this run.
+* @param baseline Results of the baseline, may be empty.
+*/
+void printResults(const std::vector<BenchmarkResult>& results, const std::vector<BenchmarkResult>& baseline) {
+  printf("%-24s %12s %10s %10s %10s\n", "benchmark", "ns/op", "allocs/op", "peak B", "vs base");
+
+  for (const BenchmarkResult& result : results) {
+    const BenchmarkResult* base = find(baseline, result.name);
+    char change[16] = "-";
+
+    if (base != NULL && base->nsPerOp > 0) {
+      snprintf(change, sizeof(change), "%+.1f %%", (result.nsPerOp / base->nsPerOp - 1.0) * 100.0);
+    }
+
+    printf("%-24s %12.1f %10.2f %10zu %10s\n", result.name.c_str(), result.nsPerOp, result.allocsPerOp, result.peakHeap, change);
+  }
+}
@@ -0,0 +1,123 @@
+/**
+* Benchmark.h
+* Declaration of the benchmark runner and baseline handling.
+*
+* A benchmark runs a code path in a timed loop and reports the time per operation, the heap
+* allocations per operation and the peak heap size above the size before the loop. Results are
+* saved to a baseline file and later runs are compared against it.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "Allocations.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Number of timed repetitions, the fastest one is reported.
+#define BENCHMARK_REPETITIONS 5
+
+// Struct to hold the result of a benchmark.
+struct BenchmarkResult {
+  std::string name;
+  double nsPerOp;      // Time per operation of the fastest repetition.
+  double allocsPerOp;  // Heap allocations per operation.
+  size_t peakHeap;     // Peak heap size during the loop above the size before it, in bytes.
+};
+
+/**
+* Measures a code path.
+* The body runs once untimed to warm up caches and lazily allocated state, then for the given
+* number of iterations in each repetition.
+*
+* @param name Stable name of the benchmark, used as the baseline key.
+* @param iterations Number of iterations per repetition.
+* @param body The code path to measure.
+* @return The benchmark result.
+*/
+template <typename Body>
+BenchmarkResult measure(const char* name, uint32_t iterations, Body body) {
+  BenchmarkResult result = { name, 0, 0, 0 };
+  body();
+
+  for (int repetition = 0; repetition < BENCHMARK_REPETITIONS; repetition++) {
+    resetAllocationStats();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < iterations; i++) {
+      body();
+    }
+
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    AllocationStats stats = allocationStats();
+
+    if (repetition == 0 || elapsed / iterations < result.nsPerOp) {
+      result.nsPerOp = elapsed / iterations;
+    }
+    result.allocsPerOp = (double)stats.allocations / iterations;
+    result.peakHeap = stats.peak;
+  }
+
+  return result;
+}
+
+/**
+* Loads a baseline file.
+*
+* @param path Path of the baseline file.
+* @param results Results to fill.
+* @return false if the file cannot be read; true otherwise.
+*/
+bool loadBaseline(const char* path, std::vector<BenchmarkResult>& results);
+
+/**
+* Saves results as the new baseline.
+*
+* @param path Path of the baseline file.
+* @param results Results to save.
+* @return false if the file cannot be written; true otherwise.
+*/
+bool saveBaseline(const char* path, const std::vector<BenchmarkResult>& results);
+
+/**
+* Compares results against a baseline and prints every regression.
+* Time may grow by the given percentage before it counts as a regression. Allocations and peak heap
+* are deterministic, so any growth counts.
+*
+* @param results Results of this run.
+* @param baseline Results of the baseline.
+* @param thresholdPercent Allowed time growth in percent.
+* @return Number of regressions found.
+*/
+int compareBaseline(const std::vector<BenchmarkResult>& results, const std::vector<BenchmarkResult>& baseline, double thresholdPercent);
+
+/**
+* Prints results as a table, with the change against the baseline when one is given.
+*
+* @param results Results of this run.
+* @param baseline Results of the baseline, may be empty.
+*/
+void printResults(const std::vector<BenchmarkResult>& results, const std::vector<BenchmarkResult>& baseline);
+
+#endif
@@ -0,0 +1,235 @@
+/**
+* main.cpp
+* Host microbenchmarks of the firmware hot paths.
+*
+* Runs the firmware's string helpers, logging, payload construction and command decoding on the
+* host, prints ns/op, allocations/op and peak heap, and compares them against a saved baseline.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Benchmark.h"
+#include "Helpers.h"
+#include "Payload.h"
+#include "JsonArena.h"
+#include "BoardProfile.h"
+#include <Preferences.h>
+#include <cstdlib>
+#include <cstring>
+
+// Results are stored here so the compiler cannot drop the measured work.
+static volatile size_t sink;
+
+static void usage(const char* name) {
+  printf("Usage: %s [options]\n"
+         "  --iterations <n>     Iterations per repetition (20000)\n"
+         "  --baseline <path>    Baseline file (benchmark-baseline.txt)\n"
+         "  --save               Save the results as the new baseline\n"
+         "  --check              Exit with an error when a result regresses against the baseline\n"
+         "  --threshold <pct>    Allowed ns/op growth for --check (25)\n",
+         name);
+}
+
+static void runBenchmarks(uint32_t iterations, std::vector<BenchmarkResult>& results) {
+  const char* timestamp = "2025-06-20T20:56:59Z";
+  uint8_t buffer[1024];
+  Preferences prefs;
+
+  // Commands as they arrive from the broker.
+  uint8_t commandJson[] = "{\"id\":\"4f1c2a\",\"watering\":true}";
+  uint8_t configJson[] = "{\"enabled\":true,\"dryThreshold\":350,\"wetThreshold\":550,\"maxRunSeconds\":120,\"soakSeconds\":600,\"flowRate\":1000,\"dailyCap\":5000,\"sensorDryRaw\":3000,\"sensorWetRaw\":1200,\"filterShift\":3}";
+  uint8_t commandMsgPack[64];
+  size_t commandMsgPackLength;
+  {
+    JsonDocument doc;
+    deserializePayload(doc, commandJson, sizeof(commandJson) - 1);
+    commandMsgPackLength = serializePayload(doc, PAYLOAD_MSGPACK, commandMsgPack, sizeof(commandMsgPack));
+  }
+
+  // Logging goes to the serial port, which is discarded here.
+  FILE* null = fopen("/dev/null", "w");
+  Serial.redirect(null);
+
+  results.push_back(measure("quotation", iterations, [&]() {
+    sink = quotation("timestamp").length();
+  }));
+
+  results.push_back(measure("getUtcTimeString", iterations, [&]() {
+    sink = getUtcTimeString().length();
+  }));
+
+  results.push_back(measure("formatUtcTime", iterations, [&]() {
+    char timestamp[UTC_TIME_LENGTH];
+    sink = formatUtcTime(timestamp, sizeof(timestamp));
+  }));
+
+  results.push_back(measure("debug", iterations, [&]() {
+    debug(CMD, "Posting data package to MQTT broker '%s' on topic '%s'.", "192.168.1.10", "plants/balcony/status");
+  }));
+
+  // Former constructMqttMessage() path, the status message built by String concatenation.
+  results.push_back(measure("status_legacy_string", iterations, [&]() {
+    sink = constructLegacyStatusMessage(timestamp, true, 512).length();
+  }));
+
+  results.push_back(measure("status_json", iterations, [&]() {
+    JsonDocument doc;
+    constructStatusPayload(doc, timestamp, true, 512);
+    sink = serializePayload(doc, PAYLOAD_JSON, buffer, sizeof(buffer));
+  }));
+
+  // The status path of the network task, with documents in the static arena.
+  static uint8_t arenaBuffer[8192] __attribute__((aligned(8)));
+  JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+
+  results.push_back(measure("status_json_arena", iterations, [&]() {
+    JsonDocument doc(&arena);
+    char now[UTC_TIME_LENGTH];
+    formatUtcTime(now, sizeof(now));
+    constructStatusPayload(doc, now, true, 512);
+    sink = serializePayload(doc, PAYLOAD_JSON, buffer, sizeof(buffer));
+  }));
+
+  results.push_back(measure("status_msgpack", iterations, [&]() {
+    JsonDocument doc;
+    constructStatusPayload(doc, timestamp, true, 512);
+    sink = serializePayload(doc, PAYLOAD_MSGPACK, buffer, sizeof(buffer));
+  }));
+
+  // Same decoding as serverResponse() in the sketch.
+  results.push_back(measure("command_json", iterations, [&]() {
+    JsonDocument doc;
+    deserializePayload(doc, commandJson, sizeof(commandJson) - 1);
+    const char* commandId = doc["id"] | "";
+    sink = strlen(commandId) + (doc["watering"] ? 1 : 0);
+  }));
+
+  results.push_back(measure("command_json_arena", iterations, [&]() {
+    JsonDocument doc(&arena);
+    deserializePayload(doc, commandJson, sizeof(commandJson) - 1);
+    const char* commandId = doc["id"] | "";
+    sink = strlen(commandId) + (doc["watering"] ? 1 : 0);
+  }));
+
+  results.push_back(measure("command_msgpack", iterations, [&]() {
+    JsonDocument doc;
+    deserializePayload(doc, commandMsgPack, commandMsgPackLength);
+    const char* commandId = doc["id"] | "";
+    sink = strlen(commandId) + (doc["watering"] ? 1 : 0);
+  }));
+
+  results.push_back(measure("config_json", iterations, [&]() {
+    JsonDocument doc;
+    deserializePayload(doc, configJson, sizeof(configJson) - 1);
+
+    WateringParams params = {};
+    mergeConfigPayload(doc, params);
+    sink = params.dailyCap;
+  }));
+
+  // The get_config handler of the setup portal, without the WebSocket send.
+  results.push_back(measure("get_config", iterations, [&]() {
+    JsonDocument response;
+    constructConfigPayload(response, prefs);
+
+    String json;
+    serializeJson(response, json);
+    sink = json.length();
+  }));
+
+  // Status LED update through the template with the host board's mock backend.
+  BoardNotifications notifications;
+  notifications.visual.initializePixels();
+  uint8_t pixel = 0;
+  results.push_back(measure("notification_pixel", iterations, [&]() {
+    notifications.visual.singlePixel(pixel++ & 1, 0, 255, 0);
+    sink = notifications.visual.output().shows();
+  }));
+
+  Serial.redirect(stdout);
+  fclose(null);
+}
+
+int main(int argc, char** argv) {
+  uint32_t iterations = 20000;
+  const char* baselinePath = "benchmark-baseline.txt";
+  bool save = false;
+  bool check = false;
+  double threshold = 25;
+
+  for (int i = 1; i < argc; i++) {
+    const char* option = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (strcmp(option, "--save") == 0) {
+      save = true;
+    } else if (strcmp(option, "--check") == 0) {
+      check = true;
+    } else if (strcmp(option, "--iterations") == 0 && value != NULL) {
+      iterations = strtoul(value, NULL, 10);
+      i++;
+    } else if (strcmp(option, "--baseline") == 0 && value != NULL) {
+      baselinePath = value;
+      i++;
+    } else if (strcmp(option, "--threshold") == 0 && value != NULL) {
+      threshold = strtod(value, NULL);
+      i++;
+    } else {
+      usage(argv[0]);
+      return strcmp(option, "--help") == 0 ? 0 : 1;
+    }
+  }
+
+  if (iterations == 0) {
+    iterations = 1;
+  }
+
+  std::vector<BenchmarkResult> baseline;
+  bool hasBaseline = loadBaseline(baselinePath, baseline);
+
+  std::vector<BenchmarkResult> results;
+  runBenchmarks(iterations, results);
+  printResults(results, baseline);
+
+  if (save) {
+    if (!saveBaseline(baselinePath, results)) {
+      fprintf(stderr, "Cannot write baseline '%s'.\n", baselinePath);
+      return 1;
+    }
+    printf("Baseline saved to '%s'.\n", baselinePath);
+  }
+
+  if (check) {
+    if (!hasBaseline) {
+      fprintf(stderr, "No baseline at '%s', run with --save first.\n", baselinePath);
+      return 1;
+    }
+
+    int regressions = compareBaseline(results, baseline, threshold);
+    if (regressions > 0) {
+      printf("%d regression(s) against '%s'.\n", regressions, baselinePath);
+      return 2;
+    }
+    printf("No regressions against '%s'.\n", baselinePath);
+  }
+
+  return 0;
+}
@@ -0,0 +1,345 @@
+/**
+* Arduino.cpp
+* Host shim of the Arduino core for building firmware sources on Linux.
+*
+* This file contains the implementation of the host time functions and of String.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+#include <chrono>
+#include <thread>
+
+static std::chrono::steady_clock::time_point startTime() {
+  static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  return start;
+}
+
+/**
+* Re-maps a number from one range to another, as the Arduino core does.
+*/
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  // arduino-esp32 returns the lower output bound for an empty input range.
+  if (in_max == in_min) {
+    return out_min;
+  }
+
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+/**
+* Returns the time since the first call in milliseconds.
+*/
+uint32_t millis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime()).count();
+}
+
+/**
+* Returns the time since the first call in microseconds.
+*/
+uint32_t micros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime()).count();
+}
+
+/**
+* Sleeps for the given time in milliseconds.
+*/
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+}
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration) {
+}
+
+void noTone(uint8_t pin) {
+}
+
+/**
+* Returns the core the caller runs on, always zero on the host.
+*/
+int xPortGetCoreID() {
+  return 0;
+}
+
+/**
+* Fills the broken-down local time of the host clock.
+*/
+bool getLocalTime(struct tm* info, uint32_t) {
+  time_t now = time(NULL);
+  return localtime_r(&now, info) != NULL;
+}
+
+HardwareSerial Serial;
+
+HardwareSerial::HardwareSerial()
+  : _stream(stdout) {
+}
+
+void HardwareSerial::redirect(FILE* stream) {
+  _stream = stream;
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  int written = vfprintf(_stream, format, args);
+  va_end(args);
+
+  return written > 0 ? written : 0;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  return fwrite(buffer, 1, size, _stream);
+}
+
+String::String(const char* str)
+  : _heap(NULL), _capacity(SSO_CAPACITY), _length(0), _inline{} {
+  if (str != NULL) {
+    copy(str, strlen(str));
+  }
+}
+
+String::String(const String& other)
+  : String() {
+  copy(other.c_str(), other._length);
+}
+
+String::String(String&& other) noexcept
+  : _heap(other._heap), _capacity(other._capacity), _length(other._length), _inline{} {
+  memcpy(_inline, other._inline, sizeof(_inline));
+  other._heap = NULL;
+  other._capacity = SSO_CAPACITY;
+  other._length = 0;
+  other._inline[0] = 0;
+}
+
+String::String(char c)
+  : String() {
+  char str[2] = { c, 0 };
+  copy(str, 1);
+}
+
+String::String(int value, unsigned char base)
+  : String((long)value, base) {
+}
+
+String::String(unsigned int value, unsigned char base)
+  : String((unsigned long)value, base) {
+}
+
+String::String(long value, unsigned char base)
+  : String() {
+  char str[2 + 8 * sizeof(long)];
+  if (base == 10) {
+    snprintf(str, sizeof(str), "%ld", value);
+  } else {
+    snprintf(str, sizeof(str), base == 16 ? "%lx" : "%lo", (unsigned long)value);
+  }
+  copy(str, strlen(str));
+}
+
+String::String(unsigned long value, unsigned char base)
+  : String() {
+  char str[1 + 8 * sizeof(unsigned long)];
+  snprintf(str, sizeof(str), base == 16 ? "%lx" : (base == 8 ? "%lo" : "%lu"), value);
+  copy(str, strlen(str));
+}
+
+String::String(float value, unsigned int decimalPlaces)
+  : String((double)value, decimalPlaces) {
+}
+
+String::String(double value, unsigned int decimalPlaces)
+  : String() {
+  char str[64];
+  snprintf(str, sizeof(str), "%.*f", decimalPlaces, value);
+  copy(str, strlen(str));
+}
+
+String::~String() {
+  release();
+}
+
+String& String::operator=(const String& other) {
+  if (this != &other) {
+    copy(other.c_str(), other._length);
+  }
+  return *this;
+}
+
+String& String::operator=(String&& other) noexcept {
+  if (this != &other) {
+    release();
+    _heap = other._heap;
+    _capacity = other._capacity;
+    _length = other._length;
+    memcpy(_inline, other._inline, sizeof(_inline));
+    other._heap = NULL;
+    other._capacity = SSO_CAPACITY;
+    other._length = 0;
+    other._inline[0] = 0;
+  }
+  return *this;
+}
+
+String& String::operator=(const char* str) {
+  copy(str != NULL ? str : "", str != NULL ? strlen(str) : 0);
+  return *this;
+}
+
+bool String::reserve(unsigned int size) {
+  if (size <= _capacity) {
+    return true;
+  }
+
+  // Grow to the exact size like arduino-esp32, every growth is a realloc.
+  char* heap = (char*)realloc(_heap, size + 1);
+  if (heap == NULL) {
+    return false;
+  }
+
+  if (_heap == NULL) {
+    memcpy(heap, _inline, _length + 1);
+  }
+
+  _heap = heap;
+  _capacity = size;
+  return true;
+}
+
+bool String::concat(const char* str, unsigned int length) {
+  if (str == NULL || !reserve(_length + length)) {
+    return false;
+  }
+
+  memmove(buffer() + _length, str, length);
+  _length += length;
+  buffer()[_length] = 0;
+  return true;
+}
+
+bool String::concat(const char* str) {
+  return str != NULL && concat(str, strlen(str));
+}
+
+bool String::concat(const String& other) {
+  return concat(other.c_str(), other._length);
+}
+
+bool String::concat(char c) {
+  return concat(&c, 1);
+}
+
+String& String::operator+=(const String& other) {
+  concat(other);
+  return *this;
+}
+
+String& String::operator+=(const char* str) {
+  concat(str);
+  return *this;
+}
+
+String& String::operator+=(char c) {
+  concat(c);
+  return *this;
+}
+
+bool String::operator==(const String& other) const {
+  return _length == other._length && memcmp(c_str(), other.c_str(), _length) == 0;
+}
+
+bool String::operator==(const char* str) const {
+  return strcmp(c_str(), str != NULL ? str : "") == 0;
+}
+
+bool String::operator!=(const String& other) const {
+  return !(*this == other);
+}
+
+bool String::operator!=(const char* str) const {
+  return !(*this == str);
+}
+
+const char* String::c_str() const {
+  return _heap != NULL ? _heap : _inline;
+}
+
+unsigned int String::length() const {
+  return _length;
+}
+
+bool String::isEmpty() const {
+  return _length == 0;
+}
+
+char* String::buffer() {
+  return _heap != NULL ? _heap : _inline;
+}
+
+void String::copy(const char* str, unsigned int length) {
+  if (!reserve(length)) {
+    return;
+  }
+
+  memmove(buffer(), str, length);
+  _length = length;
+  buffer()[_length] = 0;
+}
+
+void String::release() {
+  free(_heap);
+  _heap = NULL;
+  _capacity = SSO_CAPACITY;
+  _length = 0;
+  _inline[0] = 0;
+}
+
+String operator+(const String& lhs, const String& rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+
+String operator+(const String& lhs, const char* rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+
+String operator+(const char* lhs, const String& rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+
+String operator+(const String& lhs, char rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
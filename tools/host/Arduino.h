@@ -0,0 +1,176 @@
+/**
+* Arduino.h
+* Host shim of the Arduino core for building firmware sources on Linux.
+*
+* This file provides the subset of the Arduino and FreeRTOS API that the firmware headers and the
+* host-buildable sources (Payload, CommandTracker, WateringController, WateringHistory types) rely
+* on, so the host tools can link the same code that runs on the device. String follows the memory
+* behaviour of arduino-esp32: up to 11 characters are stored inline, longer contents live in a heap
+* buffer of exact size that is grown with realloc.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+
+// FreeRTOS types used in firmware headers.
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void* SemaphoreHandle_t;
+typedef void* QueueHandle_t;
+
+#define constrain(amount, low, high) ((amount) < (low) ? (low) : ((amount) > (high) ? (high) : (amount)))
+
+/**
+* Re-maps a number from one range to another, as the Arduino core does.
+*/
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+/**
+* Returns the time since the first call in milliseconds.
+*/
+uint32_t millis();
+
+/**
+* Returns the time since the first call in microseconds.
+*/
+uint32_t micros();
+
+/**
+* Sleeps for the given time in milliseconds.
+*/
+void delay(uint32_t ms);
+
+// GPIO and tone calls of the output backends, without effect on the host.
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+/**
+* Returns the core the caller runs on, always zero on the host.
+*/
+int xPortGetCoreID();
+
+/**
+* Fills the broken-down local time of the host clock.
+*/
+bool getLocalTime(struct tm* info, uint32_t ms = 5000);
+
+class String {
+public:
+  String(const char* str = "");
+  String(const String& other);
+  String(String&& other) noexcept;
+  explicit String(char c);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(float value, unsigned int decimalPlaces = 2);
+  explicit String(double value, unsigned int decimalPlaces = 2);
+  ~String();
+
+  String& operator=(const String& other);
+  String& operator=(String&& other) noexcept;
+  String& operator=(const char* str);
+
+  bool reserve(unsigned int size);
+  bool concat(const char* str, unsigned int length);
+  bool concat(const char* str);
+  bool concat(const String& other);
+  bool concat(char c);
+
+  String& operator+=(const String& other);
+  String& operator+=(const char* str);
+  String& operator+=(char c);
+
+  bool operator==(const String& other) const;
+  bool operator==(const char* str) const;
+  bool operator!=(const String& other) const;
+  bool operator!=(const char* str) const;
+
+  const char* c_str() const;
+  unsigned int length() const;
+  bool isEmpty() const;
+
+private:
+  // Inline capacity of arduino-esp32 on 32-bit targets, excluding the terminator.
+  static const unsigned int SSO_CAPACITY = 11;
+
+  char* buffer();
+  void copy(const char* str, unsigned int length);
+  void release();
+
+  char* _heap;
+  unsigned int _capacity;
+  unsigned int _length;
+  char _inline[SSO_CAPACITY + 1];
+};
+
+// Type of the concatenation temporaries in the Arduino core, ArduinoJson adapts it like String.
+class StringSumHelper : public String {
+public:
+  using String::String;
+};
+
+// Serial port that prints to stdout, or to the stream set with redirect().
+class HardwareSerial {
+public:
+  HardwareSerial();
+
+  void redirect(FILE* stream);
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+  size_t write(const uint8_t* buffer, size_t size);
+
+private:
+  FILE* _stream;
+};
+
+extern HardwareSerial Serial;
+
+String operator+(const String& lhs, const String& rhs);
+String operator+(const String& lhs, const char* rhs);
+String operator+(const char* lhs, const String& rhs);
+String operator+(const String& lhs, char rhs);
+
+#endif
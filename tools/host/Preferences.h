@@ -0,0 +1,57 @@
+/**
+* Preferences.h
+* Host shim of the ESP32 Preferences library.
+*
+* This file provides a Preferences class that stores nothing: reads return the default value and
+* writes are accepted and dropped, which is what the host tools need from persisted settings.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include "Arduino.h"
+
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false) { return true; }
+  void end() {}
+  bool clear() { return true; }
+
+  bool getBool(const char* key, bool defaultValue = false) { return defaultValue; }
+  uint8_t getUChar(const char* key, uint8_t defaultValue = 0) { return defaultValue; }
+  uint16_t getUShort(const char* key, uint16_t defaultValue = 0) { return defaultValue; }
+  int32_t getInt(const char* key, int32_t defaultValue = 0) { return defaultValue; }
+  uint32_t getULong(const char* key, uint32_t defaultValue = 0) { return defaultValue; }
+  String getString(const char* key, String defaultValue = String()) { return defaultValue; }
+  size_t getBytes(const char* key, void* buffer, size_t length) { return 0; }
+
+  size_t putBool(const char* key, bool value) { return sizeof(value); }
+  size_t putUChar(const char* key, uint8_t value) { return sizeof(value); }
+  size_t putUShort(const char* key, uint16_t value) { return sizeof(value); }
+  size_t putInt(const char* key, int32_t value) { return sizeof(value); }
+  size_t putULong(const char* key, uint32_t value) { return sizeof(value); }
+  size_t putString(const char* key, const String& value) { return value.length(); }
+  size_t putBytes(const char* key, const void* value, size_t length) { return length; }
+};
+
+#endif
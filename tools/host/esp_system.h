@@ -0,0 +1,4 @@
+/**
+* esp_system.h
+* Host shim, the firmware headers include it but the host tools use nothing from it.
+*/
@@ -0,0 +1,15 @@
+/**
+* esp_task_wdt.h
+* Host shim, the watchdog calls of the firmware do nothing on the host.
+*/
+#ifndef HOST_ESP_TASK_WDT_H
+#define HOST_ESP_TASK_WDT_H
+
+typedef int esp_err_t;
+
+inline esp_err_t esp_task_wdt_init(uint32_t timeout, bool panic) { return 0; }
+inline esp_err_t esp_task_wdt_add(void* task) { return 0; }
+inline esp_err_t esp_task_wdt_reset() { return 0; }
+inline esp_err_t esp_task_wdt_delete(void* task) { return 0; }
+
+#endif
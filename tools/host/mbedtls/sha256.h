@@ -0,0 +1,17 @@
+/**
+* sha256.h
+* Host shim of the mbedTLS SHA-256 context type.
+*
+* Only the type is needed to compile firmware headers on the host, the host tools do not hash.
+*/
+
+#ifndef HOST_MBEDTLS_SHA256_H
+#define HOST_MBEDTLS_SHA256_H
+
+#include <cstdint>
+
+typedef struct {
+  uint8_t opaque[128];
+} mbedtls_sha256_context;
+
+#endif
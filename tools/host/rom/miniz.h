@@ -0,0 +1,13 @@
+/**
+* miniz.h
+* Host shim of the ROM miniz decompressor types.
+*
+* Only the types are needed to compile firmware headers on the host, the host tools do not inflate.
+*/
+
+#ifndef HOST_ROM_MINIZ_H
+#define HOST_ROM_MINIZ_H
+
+typedef struct tinfl_decompressor_tag tinfl_decompressor;
+
+#endif
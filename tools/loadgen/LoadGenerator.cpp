@@ -0,0 +1,615 @@
+/**
+* LoadGenerator.cpp
+* Implementation of the fleet load generator.
+*
+* This file contains the implementation for the LoadGenerator class.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "LoadGenerator.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Retry delay after a failed connect, as used by the firmware.
+#define RECONNECT_DELAY_US 4000000ULL
+
+// Interval of the progress report.
+#define REPORT_INTERVAL_US 5000000ULL
+
+// Payload buffer, the firmware uses the same MQTT buffer size.
+#define PAYLOAD_BUFFER_SIZE 1024
+
+/**
+* Constructs a LoadGenerator object.
+*
+* @param options The load generator settings.
+*/
+LoadGenerator::LoadGenerator(const LoadOptions& options)
+  : _options(options),
+    _controller(options.devices),
+    _epoll(-1),
+    _address{},
+    _addressLength(0),
+    _random(options.seed),
+    _current(0),
+    _start(0),
+    _online(0),
+    _nextCommand(0),
+    _baselineMemory(0) {
+}
+
+LoadGenerator::~LoadGenerator() {
+  _clients.clear();
+
+  if (_epoll >= 0) {
+    close(_epoll);
+  }
+}
+
+/**
+* Runs the simulation for the configured duration and prints the report.
+*
+* @return false if the broker address could not be resolved or epoll failed; true otherwise.
+*/
+bool LoadGenerator::run() {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = NULL;
+  std::string port = std::to_string(_options.port);
+
+  if (getaddrinfo(_options.host.c_str(), port.c_str(), &hints, &result) != 0 || result == NULL) {
+    fprintf(stderr, "Cannot resolve broker '%s'.\n", _options.host.c_str());
+    return false;
+  }
+
+  memcpy(&_address, result->ai_addr, result->ai_addrlen);
+  _addressLength = result->ai_addrlen;
+  freeaddrinfo(result);
+
+  // Every device holds one socket.
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < _options.devices + 64) {
+    limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, _options.devices + 64);
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  _epoll = epoll_create1(EPOLL_CLOEXEC);
+  if (_epoll < 0) {
+    perror("epoll_create1");
+    return false;
+  }
+
+  _baselineMemory = residentMemory();
+
+  // Devices use the same client id and topic layout as the firmware, under a common prefix.
+  char id[32];
+  for (uint32_t i = 0; i <= _options.devices; i++) {
+    std::unique_ptr<Client> client(new Client());
+
+    if (i < _options.devices) {
+      snprintf(id, sizeof(id), "dev%06u", i);
+    } else {
+      snprintf(id, sizeof(id), "fleet-controller");
+    }
+
+    std::string topic = _options.prefix + "/" + id;
+    client->clientId = _options.prefix + "-" + id;
+    client->statusTopic = topic + "/status";
+    client->commandTopic = topic + "/cmd";
+    client->configTopic = topic + "/config";
+    client->eventTopic = topic + "/event";
+    client->ackTopic = topic + "/ack";
+    _clients.push_back(std::move(client));
+  }
+
+  _start = now();
+
+  // Connect storm: devices arrive at the configured rate, with jitter of one connect slot.
+  std::uniform_real_distribution<double> slot(0.0, 1.0);
+  for (uint32_t i = 0; i < _options.devices; i++) {
+    uint64_t offset = _options.connectRate > 0 ? (uint64_t)((i + slot(_random)) * 1000000.0 / _options.connectRate) : 0;
+    schedule(_start + offset, i, TIMER_CONNECT);
+  }
+
+  schedule(_start, _controller, TIMER_CONNECT);
+  schedule(_start + REPORT_INTERVAL_US, 0, TIMER_REPORT);
+  if (_options.stormAtSeconds > 0) {
+    schedule(_start + _options.stormAtSeconds * 1000000ULL, 0, TIMER_STORM);
+  }
+
+  uint64_t end = _start + _options.durationSeconds * 1000000ULL;
+  epoll_event events[256];
+
+  printf("Simulating %u devices against %s:%u for %u s, %u ms interval, %u commands/s.\n", _options.devices, _options.host.c_str(), _options.port, _options.durationSeconds, _options.intervalMs, _options.commandRate);
+
+  while (now() < end) {
+    // Sleep until the next timer is due, in whole milliseconds.
+    int timeout = 100;
+    if (!_timers.empty()) {
+      uint64_t current = now();
+      timeout = _timers.top().due <= current ? 0 : (int)std::min<uint64_t>((_timers.top().due - current + 999) / 1000, 100);
+    }
+
+    int count = epoll_wait(_epoll, events, 256, timeout);
+    if (count < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+      handleEvent(events[i].data.u32, events[i].events);
+    }
+
+    uint64_t current = now();
+    while (!_timers.empty() && _timers.top().due <= current) {
+      Timer timer = _timers.top();
+      _timers.pop();
+      fire(timer);
+    }
+  }
+
+  printReport(now() - _start);
+
+  // Leave gracefully, so the broker does not publish every last-will.
+  for (uint32_t i = 0; i < _clients.size(); i++) {
+    if (_clients[i]->state == LINK_ONLINE) {
+      _clients[i]->mqtt.disconnect();
+      _clients[i]->mqtt.flush();
+    }
+    _clients[i]->mqtt.close();
+  }
+
+  return true;
+}
+
+void LoadGenerator::onConnack(MqttConnection& connection, uint8_t returnCode) {
+  Client& client = *_clients[_current];
+
+  if (returnCode != 0) {
+    fprintf(stderr, "%s refused with code %u.\n", client.clientId.c_str(), returnCode);
+    _counters.connectFailures++;
+
+    // The connection is dropped by handleEvent() once the receive buffer is no longer in use.
+    client.state = LINK_OFFLINE;
+    return;
+  }
+
+  uint64_t current = now();
+  client.state = LINK_ONLINE;
+  _counters.connects++;
+  _connectLatency.push_back(current - client.connectStart);
+
+  if (_current == _controller) {
+    // Collect the acks of the whole fleet.
+    connection.subscribe(_options.prefix + "/+/ack", 0);
+    if (_options.commandRate > 0) {
+      schedule(current + 1000000ULL / _options.commandRate, _current, TIMER_COMMAND);
+    }
+  } else {
+    // Same subscriptions as connectToMqttBroker() in the firmware.
+    connection.subscribe(client.commandTopic, 1);
+    connection.subscribe(client.configTopic, 1);
+    _online++;
+
+    publishStatus(client);
+    schedule(current + jittered(_options.intervalMs * 1000ULL), _current, TIMER_STATUS);
+  }
+
+  schedule(current + _options.keepAlive * 500000ULL, _current, TIMER_PING);
+}
+
+void LoadGenerator::onPublish(MqttConnection&, const char* topic, size_t topicLength, const uint8_t* payload, size_t length) {
+  Client& client = *_clients[_current];
+  std::string name(topic, topicLength);
+  _counters.received++;
+
+  if (_current == _controller) {
+    handleAck(payload, length);
+  } else if (name == client.commandTopic) {
+    handleCommand(client, payload, length, false);
+  } else if (name == client.configTopic) {
+    handleCommand(client, payload, length, true);
+  }
+}
+
+uint64_t LoadGenerator::now() {
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * 1000000ULL + time.tv_nsec / 1000;
+}
+
+void LoadGenerator::schedule(uint64_t due, uint32_t client, TimerKindEnum kind) {
+  uint32_t generation = client < _clients.size() ? _clients[client]->generation : 0;
+  _timers.push({ due, client, generation, kind });
+}
+
+void LoadGenerator::fire(const Timer& timer) {
+  uint64_t current = now();
+
+  switch (timer.kind) {
+    case TIMER_REPORT:
+      printInterval(current - _start);
+      schedule(current + REPORT_INTERVAL_US, 0, TIMER_REPORT);
+      return;
+    case TIMER_STORM:
+      // Simulate a power outage: every device drops without DISCONNECT and comes back at the connect rate.
+      printf("Connect storm: dropping %u devices.\n", _online);
+      for (uint32_t i = 0; i < _options.devices; i++) {
+        drop(i, false);
+        uint64_t offset = _options.connectRate > 0 ? (uint64_t)i * 1000000ULL / _options.connectRate : 0;
+        schedule(current + offset, i, TIMER_CONNECT);
+      }
+      return;
+    default:
+      break;
+  }
+
+  Client& client = *_clients[timer.client];
+
+  // Timers of a previous connection are stale.
+  if (timer.generation != client.generation) {
+    return;
+  }
+
+  switch (timer.kind) {
+    case TIMER_CONNECT:
+      if (client.state == LINK_OFFLINE) {
+        startConnect(timer.client);
+      }
+      break;
+    case TIMER_STATUS:
+      if (client.state == LINK_ONLINE) {
+        _current = timer.client;
+        publishStatus(client);
+        updateInterest(timer.client);
+        schedule(current + jittered(_options.intervalMs * 1000ULL), timer.client, TIMER_STATUS);
+      }
+      break;
+    case TIMER_PING:
+      if (client.state == LINK_ONLINE) {
+        if (current - client.mqtt.lastSend >= _options.keepAlive * 500000ULL) {
+          client.mqtt.ping();
+          client.mqtt.lastSend = current;
+          updateInterest(timer.client);
+        }
+        schedule(current + _options.keepAlive * 500000ULL, timer.client, TIMER_PING);
+      }
+      break;
+    case TIMER_COMMAND:
+      if (client.state == LINK_ONLINE) {
+        sendCommand();
+        updateInterest(_controller);
+        schedule(timer.due + 1000000ULL / _options.commandRate, timer.client, TIMER_COMMAND);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void LoadGenerator::startConnect(uint32_t index) {
+  Client& client = *_clients[index];
+
+  client.generation++;
+  client.connectStart = now();
+
+  if (!client.mqtt.open((const sockaddr*)&_address, _addressLength)) {
+    _counters.connectFailures++;
+    client.state = LINK_OFFLINE;
+    schedule(now() + RECONNECT_DELAY_US, index, TIMER_CONNECT);
+    return;
+  }
+
+  client.state = LINK_CONNECTING;
+
+  epoll_event event = {};
+  event.events = EPOLLIN | EPOLLOUT;
+  event.data.u32 = index;
+  epoll_ctl(_epoll, EPOLL_CTL_ADD, client.mqtt.fd(), &event);
+}
+
+void LoadGenerator::handleEvent(uint32_t index, uint32_t events) {
+  Client& client = *_clients[index];
+  _current = index;
+
+  if (events & (EPOLLERR | EPOLLHUP)) {
+    _counters.connectFailures++;
+    drop(index, true);
+    return;
+  }
+
+  if (client.state == LINK_CONNECTING && (events & EPOLLOUT)) {
+    if (!client.mqtt.finishOpen()) {
+      _counters.connectFailures++;
+      drop(index, true);
+      return;
+    }
+
+    // Devices register the retained last-will of the firmware, the controller has none.
+    client.state = LINK_HANDSHAKE;
+    if (index == _controller) {
+      client.mqtt.connect(client.clientId, _options.keepAlive, true, NULL, NULL, 0);
+    } else {
+      JsonDocument will;
+      uint8_t buffer[64];
+      constructWillPayload(will);
+      size_t length = serializePayload(will, _options.encoding, buffer, sizeof(buffer));
+      client.mqtt.connect(client.clientId, _options.keepAlive, false, client.statusTopic.c_str(), buffer, length);
+    }
+    client.mqtt.lastSend = now();
+  }
+
+  if (client.state != LINK_CONNECTING && (events & EPOLLIN)) {
+    if (!client.mqtt.receive(*this)) {
+      _counters.connectFailures++;
+      drop(index, true);
+      return;
+    }
+
+    // Refused by the broker.
+    if (client.state == LINK_OFFLINE) {
+      drop(index, true);
+      return;
+    }
+  }
+
+  updateInterest(index);
+}
+
+void LoadGenerator::drop(uint32_t index, bool reconnect) {
+  Client& client = *_clients[index];
+
+  if (!client.mqtt.isOpen()) {
+    return;
+  }
+
+  if (client.state == LINK_ONLINE && index != _controller) {
+    _online--;
+  }
+
+  epoll_ctl(_epoll, EPOLL_CTL_DEL, client.mqtt.fd(), NULL);
+  client.mqtt.close();
+  client.state = LINK_OFFLINE;
+  client.generation++;
+
+  if (reconnect) {
+    schedule(now() + RECONNECT_DELAY_US, index, TIMER_CONNECT);
+  }
+}
+
+void LoadGenerator::updateInterest(uint32_t index) {
+  Client& client = *_clients[index];
+
+  if (!client.mqtt.isOpen()) {
+    return;
+  }
+
+  if (client.state != LINK_CONNECTING && !client.mqtt.flush()) {
+    _counters.connectFailures++;
+    drop(index, true);
+    return;
+  }
+
+  // Watch for writability only while data is queued or the TCP connect is pending.
+  epoll_event event = {};
+  event.events = EPOLLIN | (client.state == LINK_CONNECTING || client.mqtt.wantsWrite() ? (uint32_t)EPOLLOUT : 0);
+  event.data.u32 = index;
+  epoll_ctl(_epoll, EPOLL_CTL_MOD, client.mqtt.fd(), &event);
+}
+
+void LoadGenerator::publishDevice(Client& client, const std::string& topic, const JsonDocument& doc, uint8_t qos, bool retained) {
+  static uint8_t buffer[PAYLOAD_BUFFER_SIZE];
+  size_t length = serializePayload(doc, _options.encoding, buffer, sizeof(buffer));
+
+  client.mqtt.publish(topic, buffer, length, qos, retained);
+  client.mqtt.lastSend = now();
+  _counters.published++;
+}
+
+void LoadGenerator::publishStatus(Client& client) {
+  // Wander the moisture sensor so the payloads are not all identical.
+  std::uniform_int_distribution<int> raw(client.controller.params().sensorWetRaw, client.controller.params().sensorDryRaw);
+  client.controller.sampleMoisture(raw(_random));
+
+  char timestamp[24];
+  time_t seconds = time(NULL);
+  tm utc;
+  gmtime_r(&seconds, &utc);
+  strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+  JsonDocument doc;
+  constructStatusPayload(doc, timestamp, client.controller.isValveOpen(), client.controller.moisture());
+  publishDevice(client, client.statusTopic, doc, 0, true);
+}
+
+void LoadGenerator::sendCommand() {
+  if (_online == 0) {
+    return;
+  }
+
+  // Pick a random online device.
+  std::uniform_int_distribution<uint32_t> pick(0, _options.devices - 1);
+  uint32_t index = pick(_random);
+  while (_clients[index]->state != LINK_ONLINE) {
+    index = (index + 1) % _options.devices;
+  }
+
+  Client& controller = *_clients[_controller];
+  uint32_t sequence = _nextCommand++;
+  char id[16];
+  snprintf(id, sizeof(id), "c%u", sequence);
+
+  JsonDocument doc;
+  doc["id"] = id;
+  doc["watering"] = !_clients[index]->controller.isValveOpen();
+
+  _pendingCommands[sequence] = now();
+  publishDevice(controller, _clients[index]->commandTopic, doc, 1, false);
+  _counters.commandsSent++;
+}
+
+void LoadGenerator::handleCommand(Client& client, const uint8_t* payload, size_t length, bool isConfig) {
+  // Same decoding, deduplication and ack as serverResponse() in the firmware.
+  JsonDocument doc;
+  if (deserializePayload(doc, payload, length)) {
+    return;
+  }
+
+  const char* commandId = doc["id"] | "";
+  JsonDocument ack;
+
+  if (commandId[0] != 0 && client.tracker.seen(commandId)) {
+    constructAckPayload(ack, commandId, "duplicate");
+    publishDevice(client, client.ackTopic, ack, 0, false);
+    return;
+  }
+
+  WateringEvent event;
+  if (isConfig) {
+    // Partial updates go through the firmware's own merge and are applied to the simulated controller.
+    WateringParams params = client.controller.params();
+    mergeConfigPayload(doc, params);
+    client.controller.setParams(params);
+  } else {
+    client.controller.requestManual(doc["watering"]);
+  }
+
+  // A config update may start or stop a run as well.
+  if (client.controller.update(now() / 1000, event)) {
+    JsonDocument eventData;
+    char timestamp[24];
+    time_t seconds = time(NULL);
+    tm utc;
+    gmtime_r(&seconds, &utc);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+    constructEventPayload(eventData, timestamp, event);
+    publishDevice(client, client.eventTopic, eventData, 0, false);
+    publishStatus(client);
+  }
+
+  if (commandId[0] != 0) {
+    client.tracker.remember(commandId);
+    constructAckPayload(ack, commandId, "accepted");
+    publishDevice(client, client.ackTopic, ack, 0, false);
+  }
+}
+
+void LoadGenerator::handleAck(const uint8_t* payload, size_t length) {
+  JsonDocument doc;
+  if (deserializePayload(doc, payload, length)) {
+    return;
+  }
+
+  const char* id = doc["id"] | "";
+  if (id[0] != 'c') {
+    return;
+  }
+
+  auto pending = _pendingCommands.find(strtoul(id + 1, NULL, 10));
+  if (pending == _pendingCommands.end()) {
+    return;
+  }
+
+  _commandLatency.push_back(now() - pending->second);
+  _pendingCommands.erase(pending);
+  _counters.commandsAcked++;
+}
+
+uint64_t LoadGenerator::jittered(uint64_t interval) {
+  std::uniform_int_distribution<int64_t> jitter(-(int64_t)(interval * _options.jitterPercent / 100), interval * _options.jitterPercent / 100);
+  return interval + jitter(_random);
+}
+
+void LoadGenerator::printInterval(uint64_t elapsed) {
+  double seconds = REPORT_INTERVAL_US / 1e6;
+
+  printf("[%5.1f s] online %u/%u, publish %.0f msg/s, deliver %.0f msg/s, commands %" PRIu64 "/%" PRIu64 " acked, failures %" PRIu64 "\n",
+         elapsed / 1e6, _online, _options.devices,
+         (_counters.published - _lastCounters.published) / seconds,
+         (_counters.received - _lastCounters.received) / seconds,
+         _counters.commandsAcked, _counters.commandsSent, _counters.connectFailures);
+
+  _lastCounters = _counters;
+}
+
+static void printPercentiles(const char* name, std::vector<uint32_t>& samples) {
+  if (samples.empty()) {
+    printf("%s: no samples\n", name);
+    return;
+  }
+
+  std::sort(samples.begin(), samples.end());
+  auto at = [&](double quantile) {
+    return samples[std::min<size_t>(samples.size() - 1, (size_t)(quantile * samples.size()))] / 1000.0;
+  };
+
+  printf("%s (ms, %zu samples): p50 %.2f, p90 %.2f, p99 %.2f, p99.9 %.2f, max %.2f\n", name, samples.size(), at(0.50), at(0.90), at(0.99), at(0.999), samples.back() / 1000.0);
+}
+
+void LoadGenerator::printReport(uint64_t elapsed) {
+  double seconds = elapsed / 1e6;
+  uint64_t bytesSent = 0;
+  uint64_t bytesReceived = 0;
+  size_t stateBytes = 0;
+
+  for (uint32_t i = 0; i < _options.devices; i++) {
+    const Client& client = *_clients[i];
+    bytesSent += client.mqtt.bytesSent;
+    bytesReceived += client.mqtt.bytesReceived;
+    stateBytes += sizeof(Client) + client.mqtt.bufferCapacity() + client.clientId.capacity() + client.statusTopic.capacity() + client.commandTopic.capacity() + client.configTopic.capacity() + client.eventTopic.capacity() + client.ackTopic.capacity();
+  }
+
+  size_t memory = residentMemory();
+
+  printf("\nDevices: %u, online at end: %u, accepted connects: %" PRIu64 ", failures: %" PRIu64 "\n", _options.devices, _online, _counters.connects, _counters.connectFailures);
+  printf("Broker throughput: %.0f msg/s published, %.0f msg/s delivered\n", _counters.published / seconds, _counters.received / seconds);
+  printf("Device traffic: %.1f kB/s out, %.1f kB/s in\n", bytesSent / seconds / 1000.0, bytesReceived / seconds / 1000.0);
+  printf("Commands: %" PRIu64 " sent, %" PRIu64 " acked, %zu outstanding\n", _counters.commandsSent, _counters.commandsAcked, _pendingCommands.size());
+  printPercentiles("Command to ack latency", _commandLatency);
+  printPercentiles("Connect to CONNACK latency", _connectLatency);
+  printf("Memory per device: %zu B state and buffers, %zu B resident\n", stateBytes / std::max<uint32_t>(_options.devices, 1), memory > _baselineMemory ? (memory - _baselineMemory) / std::max<uint32_t>(_options.devices, 1) : 0);
+}
+
+size_t LoadGenerator::residentMemory() {
+  long pages = 0;
+  long resident = 0;
+  FILE* statm = fopen("/proc/self/statm", "r");
+
+  if (statm != NULL) {
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+      resident = 0;
+    }
+    fclose(statm);
+  }
+
+  return (size_t)resident * sysconf(_SC_PAGESIZE);
+}
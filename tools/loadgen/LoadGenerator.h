@@ -0,0 +1,175 @@
+/**
+* LoadGenerator.h
+* Declaration of the fleet load generator.
+*
+* This file contains the declaration for the LoadGenerator class, which simulates a fleet of watering
+* controllers against an MQTT broker from a single epoll loop. Every virtual device speaks the device
+* protocol with the firmware's own code: payloads are built with Payload.cpp, commands are deduplicated
+* with CommandTracker and applied to a WateringController. A separate controller connection fans
+* commands out to random devices and measures the end-to-end command-to-ack latency.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef LOAD_GENERATOR_H
+#define LOAD_GENERATOR_H
+
+#include "MqttConnection.h"
+#include "Payload.h"
+#include "CommandTracker.h"
+#include "WateringController.h"
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Struct to hold the load generator settings.
+struct LoadOptions {
+  std::string host = "127.0.0.1";               // Broker host name or address.
+  uint16_t port = 1883;                         // Broker port.
+  uint32_t devices = 100;                       // Number of virtual devices.
+  uint32_t intervalMs = 2000;                   // Status publish interval per device.
+  uint32_t jitterPercent = 20;                  // Random deviation of the publish interval.
+  uint32_t connectRate = 200;                   // Device connects per second, zero for all at once.
+  uint32_t commandRate = 10;                    // Commands per second fanned out to the fleet.
+  uint32_t durationSeconds = 60;                // Length of the run.
+  uint32_t stormAtSeconds = 0;                  // Drop and reconnect every device at this time, zero to disable.
+  uint16_t keepAlive = 30;                      // MQTT keepalive in seconds.
+  PayloadEncodingEnum encoding = PAYLOAD_JSON;  // Payload encoding of every device.
+  std::string prefix = "loadgen";               // Topic prefix, devices use <prefix>/<device id>.
+  uint32_t seed = 1;                            // Seed of the random generator.
+};
+
+class LoadGenerator : public MqttHandler {
+public:
+  /**
+  * Constructs a LoadGenerator object.
+  *
+  * @param options The load generator settings.
+  */
+  explicit LoadGenerator(const LoadOptions& options);
+  ~LoadGenerator();
+
+  /**
+  * Runs the simulation for the configured duration and prints the report.
+  *
+  * @return false if the broker address could not be resolved or epoll failed; true otherwise.
+  */
+  bool run();
+
+  void onConnack(MqttConnection& connection, uint8_t returnCode) override;
+  void onPublish(MqttConnection& connection, const char* topic, size_t topicLength, const uint8_t* payload, size_t length) override;
+
+private:
+  // Enum to represent the connection state of a simulated client.
+  enum LinkStateEnum : uint8_t {
+    LINK_OFFLINE,     // Waiting for the next connect attempt.
+    LINK_CONNECTING,  // TCP connect in progress.
+    LINK_HANDSHAKE,   // CONNECT sent, waiting for CONNACK.
+    LINK_ONLINE       // Connected and subscribed.
+  };
+
+  // Enum to represent the timer types.
+  enum TimerKindEnum : uint8_t {
+    TIMER_CONNECT,  // Start a connect attempt.
+    TIMER_STATUS,   // Publish the device status.
+    TIMER_PING,     // Send a keepalive ping when idle.
+    TIMER_COMMAND,  // Send the next fleet command.
+    TIMER_REPORT,   // Print the interval report.
+    TIMER_STORM     // Drop every device connection.
+  };
+
+  // Struct to hold a simulated client, a device or the fleet controller.
+  struct Client {
+    MqttConnection mqtt;
+    LinkStateEnum state = LINK_OFFLINE;
+    uint32_t generation = 0;   // Incremented on every connect, invalidates stale timers.
+    uint64_t connectStart = 0;
+    std::string clientId;
+    std::string statusTopic;
+    std::string commandTopic;
+    std::string configTopic;
+    std::string eventTopic;
+    std::string ackTopic;
+    WateringController controller;
+    CommandTracker tracker;
+  };
+
+  // Struct to hold a scheduled timer.
+  struct Timer {
+    uint64_t due;
+    uint32_t client;
+    uint32_t generation;
+    TimerKindEnum kind;
+
+    bool operator>(const Timer& other) const { return due > other.due; }
+  };
+
+  // Struct to hold message counters.
+  struct Counters {
+    uint64_t published = 0;        // Messages sent to the broker.
+    uint64_t received = 0;         // Messages delivered by the broker.
+    uint64_t commandsSent = 0;     // Commands fanned out by the controller.
+    uint64_t commandsAcked = 0;    // Acks received by the controller.
+    uint64_t connects = 0;         // Accepted CONNECTs.
+    uint64_t connectFailures = 0;  // Failed TCP connects, refused CONNECTs and dropped links.
+  };
+
+  static uint64_t now();
+  void schedule(uint64_t due, uint32_t client, TimerKindEnum kind);
+  void fire(const Timer& timer);
+  void startConnect(uint32_t index);
+  void handleEvent(uint32_t index, uint32_t events);
+  void drop(uint32_t index, bool reconnect);
+  void updateInterest(uint32_t index);
+  void publishDevice(Client& client, const std::string& topic, const JsonDocument& doc, uint8_t qos, bool retained);
+  void publishStatus(Client& client);
+  void sendCommand();
+  void handleCommand(Client& client, const uint8_t* payload, size_t length, bool isConfig);
+  void handleAck(const uint8_t* payload, size_t length);
+  uint64_t jittered(uint64_t interval);
+  void printInterval(uint64_t elapsed);
+  void printReport(uint64_t elapsed);
+  static size_t residentMemory();
+
+  LoadOptions _options;
+  std::vector<std::unique_ptr<Client>> _clients;  // Devices first, the fleet controller last.
+  uint32_t _controller;
+  int _epoll;
+  sockaddr_storage _address;
+  socklen_t _addressLength;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> _timers;
+  std::mt19937 _random;
+  uint32_t _current;  // Client whose socket is being processed.
+  uint64_t _start;
+  uint32_t _online;
+  uint32_t _nextCommand;
+  std::unordered_map<uint32_t, uint64_t> _pendingCommands;  // Command sequence to send time.
+  std::vector<uint32_t> _commandLatency;                    // Command-to-ack latency in microseconds.
+  std::vector<uint32_t> _connectLatency;                    // TCP connect to CONNACK in microseconds.
+  Counters _counters;
+  Counters _lastCounters;
+  size_t _baselineMemory;
+};
+
+#endif
@@ -0,0 +1,387 @@
+/**
+* MqttConnection.cpp
+* Implementation of a minimal non-blocking MQTT 3.1.1 client connection.
+*
+* This file contains the implementation for the MqttConnection class.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "MqttConnection.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+// MQTT control packet types, in the upper nibble of the fixed header.
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_SUBSCRIBE 0x82
+#define MQTT_SUBACK 0x90
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_DISCONNECT 0xE0
+
+// Upper bound of a packet accepted from the broker.
+#define MQTT_MAX_PACKET 65536
+
+MqttConnection::MqttConnection()
+  : lastSend(0),
+    bytesSent(0),
+    bytesReceived(0),
+    _fd(-1),
+    _connected(false),
+    _nextPacketId(1),
+    _outOffset(0) {
+}
+
+MqttConnection::~MqttConnection() {
+  close();
+}
+
+/**
+* Starts a non-blocking TCP connect.
+*
+* @param address Broker address.
+* @param length Length of the address.
+* @return true if the connect is in progress or done; false otherwise.
+*/
+bool MqttConnection::open(const sockaddr* address, socklen_t length) {
+  close();
+
+  _fd = socket(address->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (_fd < 0) {
+    return false;
+  }
+
+  // Small packets must not wait for Nagle, latency is what is being measured.
+  int one = 1;
+  setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  if (::connect(_fd, address, length) < 0 && errno != EINPROGRESS) {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+/**
+* Completes a non-blocking TCP connect once the socket became writable.
+*
+* @return true if the TCP connection is established; false otherwise.
+*/
+bool MqttConnection::finishOpen() {
+  int error = 0;
+  socklen_t length = sizeof(error);
+
+  if (getsockopt(_fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+    return false;
+  }
+
+  return true;
+}
+
+/**
+* Queues a CONNECT packet.
+*
+* @param clientId Client identifier.
+* @param keepAlive Keepalive interval in seconds.
+* @param cleanSession Whether the broker should drop the previous session.
+* @param willTopic Last-will topic, NULL for none.
+* @param will Last-will payload.
+* @param willLength Length of the last-will payload.
+*/
+void MqttConnection::connect(const std::string& clientId, uint16_t keepAlive, bool cleanSession, const char* willTopic, const uint8_t* will, size_t willLength) {
+  size_t length = 10 + 2 + clientId.size();
+  uint8_t flags = cleanSession ? 0x02 : 0x00;
+
+  // The firmware publishes its last-will with QoS 1 and retained.
+  if (willTopic != NULL) {
+    length += 2 + strlen(willTopic) + 2 + willLength;
+    flags |= 0x04 | 0x08 | 0x20;
+  }
+
+  beginPacket(MQTT_CONNECT, length);
+  putString("MQTT", 4);
+  _out.push_back(4);  // Protocol level 3.1.1.
+  _out.push_back(flags);
+  putShort(keepAlive);
+  putString(clientId.data(), clientId.size());
+
+  if (willTopic != NULL) {
+    putString(willTopic, strlen(willTopic));
+    putString((const char*)will, willLength);
+  }
+}
+
+/**
+* Queues a PUBLISH packet.
+*
+* @param topic Topic to publish to.
+* @param payload Payload of the message.
+* @param length Length of the payload.
+* @param qos Quality of service, 0 or 1.
+* @param retained Whether the broker should retain the message.
+*/
+void MqttConnection::publish(const std::string& topic, const uint8_t* payload, size_t length, uint8_t qos, bool retained) {
+  beginPacket(MQTT_PUBLISH | (qos > 0 ? 0x02 : 0x00) | (retained ? 0x01 : 0x00), 2 + topic.size() + (qos > 0 ? 2 : 0) + length);
+  putString(topic.data(), topic.size());
+
+  if (qos > 0) {
+    putShort(_nextPacketId++);
+    if (_nextPacketId == 0) {
+      _nextPacketId = 1;
+    }
+  }
+
+  _out.insert(_out.end(), payload, payload + length);
+}
+
+/**
+* Queues a SUBSCRIBE packet with a single topic filter.
+*
+* @param filter Topic filter.
+* @param qos Maximum quality of service.
+*/
+void MqttConnection::subscribe(const std::string& filter, uint8_t qos) {
+  beginPacket(MQTT_SUBSCRIBE, 2 + 2 + filter.size() + 1);
+  putShort(_nextPacketId++);
+  if (_nextPacketId == 0) {
+    _nextPacketId = 1;
+  }
+  putString(filter.data(), filter.size());
+  _out.push_back(qos);
+}
+
+/**
+* Queues a PINGREQ packet.
+*/
+void MqttConnection::ping() {
+  beginPacket(MQTT_PINGREQ, 0);
+}
+
+/**
+* Queues a DISCONNECT packet.
+*/
+void MqttConnection::disconnect() {
+  beginPacket(MQTT_DISCONNECT, 0);
+}
+
+/**
+* Writes as much of the queued data as the socket accepts.
+*
+* @return false if the connection failed; true otherwise.
+*/
+bool MqttConnection::flush() {
+  while (_outOffset < _out.size()) {
+    ssize_t written = send(_fd, _out.data() + _outOffset, _out.size() - _outOffset, MSG_NOSIGNAL);
+
+    if (written < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+    _outOffset += written;
+    bytesSent += written;
+  }
+
+  // Keep the capacity, the next packet reuses it.
+  _out.clear();
+  _outOffset = 0;
+  return true;
+}
+
+/**
+* Reads available data and dispatches every complete packet.
+*
+* @param handler Receiver of the decoded packets.
+* @return false if the connection was closed or a packet was malformed; true otherwise.
+*/
+bool MqttConnection::receive(MqttHandler& handler) {
+  uint8_t chunk[4096];
+
+  while (true) {
+    ssize_t received = recv(_fd, chunk, sizeof(chunk), 0);
+
+    if (received == 0) {
+      return false;
+    }
+    if (received < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      return false;
+    }
+
+    bytesReceived += received;
+    _in.insert(_in.end(), chunk, chunk + received);
+  }
+
+  // Decode every complete packet: fixed header, variable length, body.
+  size_t offset = 0;
+
+  while (_in.size() - offset >= 2) {
+    size_t length = 0;
+    size_t position = offset + 1;
+    unsigned int shift = 0;
+    bool complete = false;
+
+    while (position < _in.size() && shift <= 21) {
+      uint8_t digit = _in[position++];
+      length |= (size_t)(digit & 0x7F) << shift;
+      shift += 7;
+
+      if ((digit & 0x80) == 0) {
+        complete = true;
+        break;
+      }
+    }
+
+    if (!complete) {
+      if (shift > 21) {
+        return false;
+      }
+      break;
+    }
+
+    if (length > MQTT_MAX_PACKET) {
+      return false;
+    }
+
+    if (_in.size() - position < length) {
+      break;
+    }
+
+    if (!dispatch(_in[offset], _in.data() + position, length, handler)) {
+      return false;
+    }
+
+    offset = position + length;
+  }
+
+  _in.erase(_in.begin(), _in.begin() + offset);
+  return true;
+}
+
+/**
+* Closes the socket and drops all buffered data.
+*/
+void MqttConnection::close() {
+  if (_fd >= 0) {
+    ::close(_fd);
+  }
+
+  _fd = -1;
+  _connected = false;
+  _in.clear();
+  _out.clear();
+  _outOffset = 0;
+}
+
+int MqttConnection::fd() const {
+  return _fd;
+}
+
+bool MqttConnection::isOpen() const {
+  return _fd >= 0;
+}
+
+bool MqttConnection::isConnected() const {
+  return _connected;
+}
+
+bool MqttConnection::wantsWrite() const {
+  return _outOffset < _out.size();
+}
+
+/**
+* Returns the heap memory held by the connection buffers.
+*
+* @return Buffer capacity in bytes.
+*/
+size_t MqttConnection::bufferCapacity() const {
+  return _in.capacity() + _out.capacity();
+}
+
+void MqttConnection::beginPacket(uint8_t header, size_t length) {
+  _out.push_back(header);
+
+  do {
+    uint8_t digit = length & 0x7F;
+    length >>= 7;
+    _out.push_back(length > 0 ? digit | 0x80 : digit);
+  } while (length > 0);
+}
+
+void MqttConnection::putShort(uint16_t value) {
+  _out.push_back(value >> 8);
+  _out.push_back(value & 0xFF);
+}
+
+void MqttConnection::putString(const char* str, size_t length) {
+  putShort(length);
+  _out.insert(_out.end(), (const uint8_t*)str, (const uint8_t*)str + length);
+}
+
+bool MqttConnection::dispatch(uint8_t header, const uint8_t* data, size_t length, MqttHandler& handler) {
+  switch (header & 0xF0) {
+    case MQTT_CONNACK:
+      if (length < 2) {
+        return false;
+      }
+      _connected = data[1] == 0;
+      handler.onConnack(*this, data[1]);
+      return true;
+    case MQTT_PUBLISH: {
+      uint8_t qos = (header >> 1) & 0x03;
+      if (length < 2) {
+        return false;
+      }
+
+      size_t topicLength = (data[0] << 8) | data[1];
+      size_t position = 2 + topicLength;
+      if (position + (qos > 0 ? 2 : 0) > length) {
+        return false;
+      }
+
+      if (qos > 0) {
+        // Acknowledge before handling, the handler may queue more packets.
+        beginPacket(MQTT_PUBACK, 2);
+        _out.push_back(data[position]);
+        _out.push_back(data[position + 1]);
+        position += 2;
+      }
+
+      handler.onPublish(*this, (const char*)data + 2, topicLength, data + position, length - position);
+      return true;
+    }
+    case MQTT_PUBACK:
+    case MQTT_SUBACK & 0xF0:
+    case MQTT_PINGRESP:
+      return true;
+    default:
+      return false;
+  }
+}
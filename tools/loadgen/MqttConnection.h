@@ -0,0 +1,179 @@
+/**
+* MqttConnection.h
+* Declaration of a minimal non-blocking MQTT 3.1.1 client connection.
+*
+* This file contains the declaration for the MqttConnection class, which encodes and decodes the
+* MQTT packets the firmware uses (CONNECT with last-will, PUBLISH QoS 0/1, PUBACK, SUBSCRIBE,
+* PINGREQ, DISCONNECT) on a non-blocking socket. It holds no thread or timer of its own, so
+* thousands of connections can be driven from a single epoll loop.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#ifndef MQTT_CONNECTION_H
+#define MQTT_CONNECTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+class MqttConnection;
+
+// Receives the packets decoded by MqttConnection::receive().
+class MqttHandler {
+public:
+  virtual ~MqttHandler() {}
+
+  /**
+  * Called when the broker accepted or refused the connection.
+  *
+  * @param connection The connection.
+  * @param returnCode CONNACK return code, zero when accepted.
+  */
+  virtual void onConnack(MqttConnection& connection, uint8_t returnCode) = 0;
+
+  /**
+  * Called for every PUBLISH received. QoS 1 messages are acknowledged automatically.
+  *
+  * @param connection The connection.
+  * @param topic Topic of the message, not terminated.
+  * @param topicLength Length of the topic.
+  * @param payload Payload of the message.
+  * @param length Length of the payload.
+  */
+  virtual void onPublish(MqttConnection& connection, const char* topic, size_t topicLength, const uint8_t* payload, size_t length) = 0;
+};
+
+class MqttConnection {
+public:
+  MqttConnection();
+  ~MqttConnection();
+
+  /**
+  * Starts a non-blocking TCP connect.
+  *
+  * @param address Broker address.
+  * @param length Length of the address.
+  * @return true if the connect is in progress or done; false otherwise.
+  */
+  bool open(const sockaddr* address, socklen_t length);
+
+  /**
+  * Completes a non-blocking TCP connect once the socket became writable.
+  *
+  * @return true if the TCP connection is established; false otherwise.
+  */
+  bool finishOpen();
+
+  /**
+  * Queues a CONNECT packet.
+  *
+  * @param clientId Client identifier.
+  * @param keepAlive Keepalive interval in seconds.
+  * @param cleanSession Whether the broker should drop the previous session.
+  * @param willTopic Last-will topic, NULL for none.
+  * @param will Last-will payload.
+  * @param willLength Length of the last-will payload.
+  */
+  void connect(const std::string& clientId, uint16_t keepAlive, bool cleanSession, const char* willTopic, const uint8_t* will, size_t willLength);
+
+  /**
+  * Queues a PUBLISH packet.
+  *
+  * @param topic Topic to publish to.
+  * @param payload Payload of the message.
+  * @param length Length of the payload.
+  * @param qos Quality of service, 0 or 1.
+  * @param retained Whether the broker should retain the message.
+  */
+  void publish(const std::string& topic, const uint8_t* payload, size_t length, uint8_t qos, bool retained);
+
+  /**
+  * Queues a SUBSCRIBE packet with a single topic filter.
+  *
+  * @param filter Topic filter.
+  * @param qos Maximum quality of service.
+  */
+  void subscribe(const std::string& filter, uint8_t qos);
+
+  /**
+  * Queues a PINGREQ packet.
+  */
+  void ping();
+
+  /**
+  * Queues a DISCONNECT packet.
+  */
+  void disconnect();
+
+  /**
+  * Writes as much of the queued data as the socket accepts.
+  *
+  * @return false if the connection failed; true otherwise.
+  */
+  bool flush();
+
+  /**
+  * Reads available data and dispatches every complete packet.
+  *
+  * @param handler Receiver of the decoded packets.
+  * @return false if the connection was closed or a packet was malformed; true otherwise.
+  */
+  bool receive(MqttHandler& handler);
+
+  /**
+  * Closes the socket and drops all buffered data.
+  */
+  void close();
+
+  int fd() const;
+  bool isOpen() const;
+  bool isConnected() const;
+  bool wantsWrite() const;
+
+  /**
+  * Returns the heap memory held by the connection buffers.
+  *
+  * @return Buffer capacity in bytes.
+  */
+  size_t bufferCapacity() const;
+
+  uint64_t lastSend;       // Time data was last queued, in microseconds, maintained by the caller.
+  uint64_t bytesSent;      // Bytes written to the socket.
+  uint64_t bytesReceived;  // Bytes read from the socket.
+
+private:
+  void beginPacket(uint8_t header, size_t length);
+  void putShort(uint16_t value);
+  void putString(const char* str, size_t length);
+  bool dispatch(uint8_t header, const uint8_t* data, size_t length, MqttHandler& handler);
+
+  int _fd;
+  bool _connected;
+  uint16_t _nextPacketId;
+  std::vector<uint8_t> _in;
+  std::vector<uint8_t> _out;
+  size_t _outOffset;
+};
+
+#endif
@@ -0,0 +1,108 @@
+/**
+* main.cpp
+* Command line entry point of the fleet load generator.
+*
+* Parses the options, runs the simulation and prints the report.
+*
+* @license MIT License
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "LoadGenerator.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void usage(const char* name) {
+  printf("Usage: %s [options]\n"
+         "  --host <name>        Broker host (127.0.0.1)\n"
+         "  --port <port>        Broker port (1883)\n"
+         "  --devices <n>        Number of virtual devices (100)\n"
+         "  --interval <ms>      Status publish interval per device (2000)\n"
+         "  --jitter <percent>   Random deviation of the interval (20)\n"
+         "  --connect-rate <n>   Device connects per second, 0 for all at once (200)\n"
+         "  --command-rate <n>   Commands per second fanned out to the fleet (10)\n"
+         "  --duration <s>       Length of the run (60)\n"
+         "  --storm-at <s>       Drop and reconnect every device at this time, 0 to disable (0)\n"
+         "  --keepalive <s>      MQTT keepalive (30)\n"
+         "  --msgpack            Encode device payloads as MessagePack\n"
+         "  --prefix <topic>     Topic prefix (loadgen)\n"
+         "  --seed <n>           Random seed (1)\n",
+         name);
+}
+
+int main(int argc, char** argv) {
+  LoadOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    const char* option = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (strcmp(option, "--msgpack") == 0) {
+      options.encoding = PAYLOAD_MSGPACK;
+      continue;
+    }
+
+    if (strcmp(option, "--help") == 0 || value == NULL) {
+      usage(argv[0]);
+      return strcmp(option, "--help") == 0 ? 0 : 1;
+    }
+
+    uint32_t number = strtoul(value, NULL, 10);
+    i++;
+
+    if (strcmp(option, "--host") == 0) {
+      options.host = value;
+    } else if (strcmp(option, "--port") == 0) {
+      options.port = number;
+    } else if (strcmp(option, "--devices") == 0) {
+      options.devices = number;
+    } else if (strcmp(option, "--interval") == 0) {
+      options.intervalMs = number;
+    } else if (strcmp(option, "--jitter") == 0) {
+      options.jitterPercent = number > 100 ? 100 : number;
+    } else if (strcmp(option, "--connect-rate") == 0) {
+      options.connectRate = number;
+    } else if (strcmp(option, "--command-rate") == 0) {
+      options.commandRate = number;
+    } else if (strcmp(option, "--duration") == 0) {
+      options.durationSeconds = number;
+    } else if (strcmp(option, "--storm-at") == 0) {
+      options.stormAtSeconds = number;
+    } else if (strcmp(option, "--keepalive") == 0) {
+      options.keepAlive = number;
+    } else if (strcmp(option, "--prefix") == 0) {
+      options.prefix = value;
+    } else if (strcmp(option, "--seed") == 0) {
+      options.seed = number;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (options.devices == 0 || options.intervalMs == 0 || options.keepAlive == 0) {
+    fprintf(stderr, "Devices, interval and keepalive must be greater than zero.\n");
+    return 1;
+  }
+
+  LoadGenerator generator(options);
+  return generator.run() ? 0 : 1;
+}